@@ -0,0 +1,497 @@
+#pragma once
+
+#include "expr.hpp"
+#include "bytecode.hpp"
+#include "parser.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+enum class ast_kind_t : std::uint8_t {
+    constant,
+    variable,
+    unary,
+    binary,
+    assign,
+};
+
+// Runtime counterpart of constant_t, variable_t, unary_t, binary_t and assign_t.
+struct ast_node_t {
+    ast_kind_t m_kind;
+    operation_t m_operation;
+    // constant: index into ast_t::m_constants, variable/assign: variable id, unary/binary: operand
+    std::uint32_t m_first;
+    // binary/assign: operand
+    std::uint32_t m_second;
+
+    constexpr bool operator==(const ast_node_t &) const noexcept = default;
+};
+
+// An expression whose nodes live contiguously in one arena and refer to each other by 32-bit index.
+// Children are always allocated before their parents, and a node's first operand before its second, so m_nodes is
+// in post-order and in evaluation order: every evaluator takes operands left to right, divisions included.
+struct ast_t {
+    using index_type = std::uint32_t;
+
+    std::vector<ast_node_t> m_nodes;
+    std::vector<double> m_constants;
+    index_type m_root = 0;
+
+    [[nodiscard]] constexpr const ast_node_t &operator[](const index_type index) const noexcept {
+        return m_nodes[index];
+    }
+
+    [[nodiscard]] constexpr std::size_t size() const noexcept {
+        return m_nodes.size();
+    }
+
+    [[nodiscard]] constexpr double constant_value(const ast_node_t &node) const noexcept {
+        return m_constants[node.m_first];
+    }
+
+    constexpr index_type constant(const double value) {
+        m_constants.push_back(value);
+        return allocate({ast_kind_t::constant, operation_t::assign,
+                         static_cast<std::uint32_t>(m_constants.size() - 1), 0});
+    }
+
+    constexpr index_type variable(const std::size_t id) {
+        return allocate({ast_kind_t::variable, operation_t::assign, static_cast<std::uint32_t>(id), 0});
+    }
+
+    constexpr index_type unary(const operation_t operation, const index_type value) {
+        return allocate({ast_kind_t::unary, operation, value, 0});
+    }
+
+    constexpr index_type binary(const operation_t operation, const index_type first, const index_type second) {
+        return allocate({ast_kind_t::binary, operation, first, second});
+    }
+
+    constexpr index_type assign(const operation_t operation, const std::size_t id, const index_type value) {
+        return allocate({ast_kind_t::assign, operation, static_cast<std::uint32_t>(id), value});
+    }
+
+    // Frees every node at once; the arena keeps its capacity for the next expression.
+    constexpr void clear() noexcept {
+        m_nodes.clear();
+        m_constants.clear();
+        m_root = 0;
+    }
+
+    [[nodiscard]] constexpr double operator()(state_t &state) const;
+
+private:
+    constexpr index_type allocate(const ast_node_t &node) {
+        m_nodes.push_back(node);
+        m_root = static_cast<index_type>(m_nodes.size() - 1);
+        return m_root;
+    }
+};
+
+// Same semantics as eval_visitor_t, walking indices instead of types. The walk recurses up to max_recursion levels
+// and continues any deeper subtree with explicit stacks, so a parsed chain of a million terms cannot overflow the
+// call stack while ordinary trees keep the cheaper recursive walk.
+struct ast_eval_visitor_t {
+    static constexpr std::size_t max_recursion = 1024;
+
+    // the arrays are cached so that each step is one indexed load rather than a chain through ast_t
+    const ast_node_t *m_nodes;
+    const double *m_constants;
+    double *m_state;
+
+    constexpr ast_eval_visitor_t(const ast_t &ast, state_t &state) : m_nodes(ast.m_nodes.data()),
+                                                                     m_constants(ast.m_constants.data()),
+                                                                     m_state(state.data()) {}
+
+    [[nodiscard]] constexpr double visit(const ast_t::index_type index) const {
+        return visit(index, 0);
+    }
+
+private:
+    [[nodiscard]] constexpr double visit(const ast_t::index_type index, const std::size_t depth) const {
+        if (depth == max_recursion) {
+            return visit_iteratively(index);
+        }
+        const auto &node = m_nodes[index];
+        switch (node.m_kind) {
+            case ast_kind_t::constant:
+                return m_constants[node.m_first];
+            case ast_kind_t::variable:
+                return m_state[node.m_first];
+            case ast_kind_t::unary:
+                return node.m_operation == operation_t::minus ? -visit(node.m_first, depth + 1)
+                                                              : visit(node.m_first, depth + 1);
+            case ast_kind_t::binary:
+                return binary(node, depth + 1);
+            case ast_kind_t::assign:
+                return store(node, visit(node.m_second, depth + 1));
+        }
+        return 0;
+    }
+
+    // operands left to right, as in eval_visitor_t and the arena order the other evaluators follow
+    [[nodiscard]] constexpr double binary(const ast_node_t &node, const std::size_t depth) const {
+        if (node.m_operation == operation_t::assign) {
+            throw std::logic_error{"not an arithmetic operation"};
+        }
+        const auto first = visit(node.m_first, depth);
+        return apply(node.m_operation, first, visit(node.m_second, depth));
+    }
+
+    [[nodiscard]] static constexpr double apply(const operation_t operation, const double first, const double second) {
+        switch (operation) {
+            case operation_t::plus:
+                return first + second;
+            case operation_t::minus:
+                return first - second;
+            case operation_t::mul:
+                return first * second;
+            default:
+                if (second == 0) {
+                    throw std::logic_error{"division by zero"};
+                }
+                return first / second;
+        }
+    }
+
+    // The recursive walk with its pending nodes and operand values on the heap: a node is visited once before its
+    // operands and once after them.
+    [[nodiscard]] constexpr double visit_iteratively(const ast_t::index_type root) const {
+        struct frame_t {
+            ast_t::index_type m_index;
+            bool m_expanded;
+        };
+        std::vector<frame_t> frames{{root, false}};
+        std::vector<double> values;
+        while (!frames.empty()) {
+            const auto [index, expanded] = frames.back();
+            frames.pop_back();
+            const auto &node = m_nodes[index];
+            switch (node.m_kind) {
+                case ast_kind_t::constant:
+                    values.push_back(m_constants[node.m_first]);
+                    break;
+                case ast_kind_t::variable:
+                    values.push_back(m_state[node.m_first]);
+                    break;
+                case ast_kind_t::unary:
+                    if (!expanded) {
+                        frames.push_back({index, true});
+                        frames.push_back({node.m_first, false});
+                    } else if (node.m_operation == operation_t::minus) {
+                        values.back() = -values.back();
+                    }
+                    break;
+                case ast_kind_t::binary:
+                    if (!expanded) {
+                        if (node.m_operation == operation_t::assign) {
+                            throw std::logic_error{"not an arithmetic operation"};
+                        }
+                        frames.push_back({index, true});
+                        frames.push_back({node.m_second, false});
+                        frames.push_back({node.m_first, false});
+                    } else {
+                        const auto second = values.back();
+                        values.pop_back();
+                        values.back() = apply(node.m_operation, values.back(), second);
+                    }
+                    break;
+                case ast_kind_t::assign:
+                    if (!expanded) {
+                        frames.push_back({index, true});
+                        frames.push_back({node.m_second, false});
+                    } else {
+                        values.back() = store(node, values.back());
+                    }
+                    break;
+            }
+        }
+        return values.back();
+    }
+
+    constexpr double store(const ast_node_t &node, const double value) const {
+        auto &variable = m_state[node.m_first];
+        switch (node.m_operation) {
+            case operation_t::assign:
+                variable = value;
+                break;
+            case operation_t::plus:
+                variable += value;
+                break;
+            case operation_t::minus:
+                variable -= value;
+                break;
+            case operation_t::mul:
+                variable *= value;
+                break;
+            case operation_t::div:
+                variable /= value;
+                break;
+        }
+        return variable;
+    }
+};
+
+constexpr double ast_t::operator()(state_t &state) const {
+    ast_eval_visitor_t visitor{*this, state};
+    return visitor.visit(m_root);
+}
+
+// Which nodes the root reaches; passes that rebuild an arena may leave others behind. Children precede their
+// parents, so one backwards sweep finds them all.
+[[nodiscard]] constexpr std::vector<bool> reachable(const ast_t &ast) {
+    std::vector<bool> result(ast.size());
+    if (ast.size() == 0) {
+        return result;
+    }
+    result[ast.m_root] = true;
+    for (auto index = static_cast<ast_t::index_type>(ast.size()); index-- > 0;) {
+        if (!result[index]) {
+            continue;
+        }
+        const auto &node = ast[index];
+        if (node.m_kind == ast_kind_t::unary || node.m_kind == ast_kind_t::binary) {
+            result[node.m_first] = true;
+        }
+        if (node.m_kind == ast_kind_t::binary || node.m_kind == ast_kind_t::assign) {
+            result[node.m_second] = true;
+        }
+    }
+    return result;
+}
+
+[[nodiscard]] constexpr std::size_t reachable_nodes(const ast_t &ast) {
+    const auto nodes = reachable(ast);
+    return static_cast<std::size_t>(std::ranges::count(nodes, true));
+}
+
+// Evaluates the arena front to back, which is evaluation order since children precede their parents. A node
+// shared by several parents (see cse.hpp) is computed once; every node in the arena is assumed to be reachable.
+// The value buffer is kept between runs so steady state does not allocate.
+struct ast_evaluator_t {
+    std::vector<double> m_values;
+
+    double run(const ast_t &ast, state_t &state) {
+        m_values.resize(std::max(m_values.size(), ast.size()));
+        auto *const values = m_values.data();
+        for (std::size_t index = 0; index < ast.size(); ++index) {
+            const auto &node = ast[static_cast<ast_t::index_type>(index)];
+            switch (node.m_kind) {
+                case ast_kind_t::constant:
+                    values[index] = ast.constant_value(node);
+                    break;
+                case ast_kind_t::variable:
+                    values[index] = state[node.m_first];
+                    break;
+                case ast_kind_t::unary:
+                    values[index] = node.m_operation == operation_t::minus ? -values[node.m_first]
+                                                                           : values[node.m_first];
+                    break;
+                case ast_kind_t::binary:
+                    values[index] = binary(node.m_operation, values[node.m_first], values[node.m_second]);
+                    break;
+                case ast_kind_t::assign:
+                    values[index] = assign(node.m_operation, state[node.m_first], values[node.m_second]);
+                    break;
+            }
+        }
+        return values[ast.m_root];
+    }
+
+private:
+    [[nodiscard]] static double binary(const operation_t operation, const double first, const double second) {
+        switch (operation) {
+            case operation_t::plus:
+                return first + second;
+            case operation_t::minus:
+                return first - second;
+            case operation_t::mul:
+                return first * second;
+            case operation_t::div:
+                if (second == 0) {
+                    throw std::logic_error{"division by zero"};
+                }
+                return first / second;
+            default:
+                throw std::logic_error{"not an arithmetic operation"};
+        }
+    }
+
+    static double assign(const operation_t operation, double &variable, const double value) noexcept {
+        switch (operation) {
+            case operation_t::assign:
+                return variable = value;
+            case operation_t::plus:
+                return variable += value;
+            case operation_t::minus:
+                return variable -= value;
+            case operation_t::mul:
+                return variable *= value;
+            case operation_t::div:
+                return variable /= value;
+        }
+        return variable;
+    }
+};
+
+// Copies an expression template into an ast_t.
+struct ast_build_visitor_t {
+    ast_t &m_ast;
+
+    constexpr explicit ast_build_visitor_t(ast_t &ast) : m_ast(ast) {}
+
+    template<Node T>
+    constexpr ast_t::index_type visit(const unary_t<T> &node) const {
+        return m_ast.unary(node.m_operation, visit(node.m_value));
+    }
+
+    template<Node First, Node Second>
+    constexpr ast_t::index_type visit(const binary_t<First, Second> &node) const {
+        const auto first = visit(node.m_first);
+        return m_ast.binary(node.m_operation, first, visit(node.m_second));
+    }
+
+    constexpr ast_t::index_type visit(const variable_t &node) const {
+        return m_ast.variable(node.m_id);
+    }
+
+    template<Node Second>
+    constexpr ast_t::index_type visit(const assign_t<Second> &node) const {
+        return m_ast.assign(node.m_operation, node.m_first.m_id, visit(node.m_second));
+    }
+
+    constexpr ast_t::index_type visit(const constant_t &node) const {
+        return m_ast.constant(node.m_value);
+    }
+};
+
+template<Node T>
+[[nodiscard]] constexpr ast_t to_ast(const T &node) {
+    ast_t ast;
+    ast_build_visitor_t visitor{ast};
+    ast.m_root = visitor.visit(node.get());
+    return ast;
+}
+
+// Parses a single statement into an ast_t.
+[[nodiscard]] inline ast_t parse_ast(const std::string_view text, const symbol_table_t &symbol_table) {
+    ast_t ast;
+    parser_t parser{text, symbol_table, ast};
+    if (!parser.next_statement()) {
+        throw parse_error{"empty expression", 0};
+    }
+    ast.m_root = parser.parse_statement();
+    if (parser.next_statement()) {
+        throw parse_error{"more than one statement", parser.m_position};
+    }
+    return ast;
+}
+
+// Lowers an ast_t into bytecode appended to `builder` and returns the register holding its value. Nodes are emitted
+// once each in arena order, so a subtree shared by several parents (see cse.hpp) is computed once; registers are
+// reused as soon as a value has no later reader, and every register is free again afterwards except the result.
+constexpr std::uint32_t compile(program_builder_t &builder, const ast_t &ast) {
+    constexpr auto none = std::numeric_limits<std::uint32_t>::max();
+    const auto size = ast.size();
+
+    // unary plus is a no-op, so readers are pointed straight at its operand
+    const auto resolve = [&ast](ast_t::index_type index) {
+        while (ast[index].m_kind == ast_kind_t::unary && ast[index].m_operation == operation_t::plus) {
+            index = ast[index].m_first;
+        }
+        return index;
+    };
+    const auto operands = [none](const ast_node_t &node) -> std::pair<std::uint32_t, std::uint32_t> {
+        switch (node.m_kind) {
+            case ast_kind_t::unary:
+                return {node.m_first, none};
+            case ast_kind_t::binary:
+                return {node.m_first, node.m_second};
+            case ast_kind_t::assign:
+                return {node.m_second, none};
+            default:
+                return {none, none};
+        }
+    };
+
+    // children precede their parents, so one backwards sweep finds every reachable node and its last reader
+    std::vector<bool> reachable(size);
+    std::vector<std::uint32_t> last_use(size, 0);
+    const auto root = resolve(ast.m_root);
+    reachable[root] = true;
+    last_use[root] = none;
+    for (auto index = static_cast<std::uint32_t>(size); index-- > 0;) {
+        if (!reachable[index] || resolve(index) != index) {
+            continue;
+        }
+        const auto [first, second] = operands(ast[index]);
+        for (const auto operand: {first, second}) {
+            if (operand != none) {
+                const auto resolved = resolve(operand);
+                reachable[resolved] = true;
+                last_use[resolved] = std::max(last_use[resolved], index);
+            }
+        }
+    }
+
+    std::vector<std::uint32_t> registers(size, none);
+    std::vector<std::uint32_t> free_registers;
+    std::uint32_t next_register = 0;
+    for (std::uint32_t index = 0; index < size; ++index) {
+        if (!reachable[index] || resolve(index) != index) {
+            continue;
+        }
+        const auto &node = ast[index];
+        auto [first, second] = operands(node);
+        first = first == none ? none : resolve(first);
+        second = second == none ? none : resolve(second);
+        const auto first_register = first == none ? none : registers[first];
+        const auto second_register = second == none ? none : registers[second];
+
+        // operands read for the last time here give their registers back before the result is allocated
+        if (first != none && last_use[first] == index) {
+            free_registers.push_back(first_register);
+        }
+        if (second != none && second != first && last_use[second] == index) {
+            free_registers.push_back(second_register);
+        }
+        std::uint32_t target;
+        if (free_registers.empty()) {
+            target = next_register++;
+        } else {
+            target = free_registers.back();
+            free_registers.pop_back();
+        }
+
+        switch (node.m_kind) {
+            case ast_kind_t::constant:
+                registers[index] = builder.constant(target, ast.constant_value(node));
+                break;
+            case ast_kind_t::variable:
+                registers[index] = builder.variable(target, node.m_first);
+                break;
+            case ast_kind_t::unary:
+                registers[index] = builder.unary(node.m_operation, target, first_register);
+                break;
+            case ast_kind_t::binary:
+                registers[index] = builder.binary(node.m_operation, target, first_register, second_register);
+                break;
+            case ast_kind_t::assign:
+                registers[index] = builder.assign(node.m_operation, target, node.m_first, first_register);
+                break;
+        }
+    }
+    return registers[root];
+}
+
+[[nodiscard]] constexpr program_t compile(const ast_t &ast) {
+    program_builder_t builder;
+    const auto result = compile(builder, ast);
+    return builder.finish(result);
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+#include "expr.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Allocator whose value-less construct() leaves trivial types uninitialised, so that resizing a large vector does
+// not touch its pages: they get mapped by whichever thread writes them first.
+template<typename T>
+struct uninitialised_allocator_t : std::allocator<T> {
+    template<typename U>
+    struct rebind {
+        using other = uninitialised_allocator_t<U>;
+    };
+
+    using std::allocator<T>::allocator;
+
+    template<typename U, typename... Args>
+    constexpr void construct(U *pointer, Args &&... args) {
+        if constexpr (sizeof...(Args) == 0 && std::is_trivially_default_constructible_v<U>) {
+            if (std::is_constant_evaluated()) {
+                std::construct_at(pointer);
+            } else {
+                ::new(static_cast<void *>(pointer)) U;
+            }
+        } else {
+            std::construct_at(pointer, std::forward<Args>(args)...);
+        }
+    }
+};
+
+// Structure-of-arrays state for many rows at once: one contiguous column per variable id.
+struct batch_t {
+    // constructor tag: allocate the columns but leave their contents for the caller to fill
+    struct uninitialised_t {
+    };
+    static constexpr uninitialised_t uninitialised{};
+
+    std::size_t m_rows;
+    std::size_t m_columns;
+    std::vector<double, uninitialised_allocator_t<double>> m_data;
+
+    constexpr batch_t(const std::size_t columns, const std::size_t rows) : m_rows(rows), m_columns(columns),
+                                                                           m_data(columns * rows, 0.0) {}
+
+    constexpr batch_t(const std::size_t columns, const std::size_t rows, uninitialised_t) : m_rows(rows),
+                                                                                            m_columns(columns),
+                                                                                            m_data(columns * rows) {}
+
+    // Every row starts out as a copy of the symbol table's initial values.
+    constexpr batch_t(const symbol_table_t &symbol_table, const std::size_t rows) : batch_t(
+            symbol_table.m_state.size(), rows) {
+        for (std::size_t id = 0; id < m_columns; ++id) {
+            std::ranges::fill(column(id), symbol_table.m_state[id]);
+        }
+    }
+
+    [[nodiscard]] constexpr std::size_t rows() const noexcept {
+        return m_rows;
+    }
+
+    [[nodiscard]] constexpr std::span<double> column(const std::size_t id) noexcept {
+        return {m_data.data() + id * m_rows, m_rows};
+    }
+
+    [[nodiscard]] constexpr std::span<const double> column(const std::size_t id) const noexcept {
+        return {m_data.data() + id * m_rows, m_rows};
+    }
+
+    [[nodiscard]] constexpr std::span<double> column(const variable_t &variable) noexcept {
+        return column(variable.m_id);
+    }
+
+    [[nodiscard]] constexpr std::span<const double> column(const variable_t &variable) const noexcept {
+        return column(variable.m_id);
+    }
+};
+
+// Number of scratch columns needed to evaluate a node with a stack discipline.
+template<typename T>
+constexpr std::size_t scratch_slots_v = 0;
+
+template<Node T>
+constexpr std::size_t scratch_slots_v<unary_t<T>> = std::max<std::size_t>(1, scratch_slots_v<T>);
+
+template<Node First, Node Second>
+constexpr std::size_t scratch_slots_v<binary_t<First, Second>> = std::max<std::size_t>(
+        std::max<std::size_t>(1, scratch_slots_v<First>), 1 + scratch_slots_v<Second>);
+
+template<Node Second>
+constexpr std::size_t scratch_slots_v<assign_t<Second>> = scratch_slots_v<Second>;
+
+// Whether evaluating a node can write to the state.
+template<typename T>
+constexpr bool writes_state_v = false;
+
+template<Node T>
+constexpr bool writes_state_v<unary_t<T>> = writes_state_v<T>;
+
+template<Node First, Node Second>
+constexpr bool writes_state_v<binary_t<First, Second>> = writes_state_v<First> || writes_state_v<Second>;
+
+template<Node Second>
+constexpr bool writes_state_v<assign_t<Second>> = true;
+
+// Either a single value shared by every row or a pointer to one value per row.
+struct lanes_t {
+    const double *m_data;
+    double m_scalar;
+
+    [[nodiscard]] constexpr bool is_scalar() const noexcept {
+        return m_data == nullptr;
+    }
+
+    [[nodiscard]] constexpr double operator[](const std::size_t i) const noexcept {
+        return is_scalar() ? m_scalar : m_data[i];
+    }
+};
+
+// Evaluates a node over a block of rows, one whole column per node, so the inner loops are plain array arithmetic
+// dispatched to the SIMD kernels of the running CPU. The error policy sees one check per division per block, so a
+// sticky_error_t flag says whether any row divided by zero; those rows hold inf or NaN.
+template<ErrorPolicy Policy = throw_on_error_t>
+struct batch_eval_visitor_t {
+    static constexpr std::size_t block_size = 256;
+
+    batch_t &m_batch;
+    double *m_scratch;
+    const simd_kernels_t &m_kernels;
+    [[no_unique_address]] const Policy m_policy;
+    std::size_t m_offset = 0;
+    std::size_t m_count = 0;
+
+    batch_eval_visitor_t(batch_t &batch, double *scratch, const simd_kernels_t &kernels = simd_kernels(),
+                         const Policy &policy = {})
+            : m_batch(batch), m_scratch(scratch), m_kernels(kernels), m_policy(policy) {}
+
+    template<Node T>
+    [[nodiscard]] lanes_t visit(const unary_t<T> &node, const std::size_t slot) const {
+        const auto value = visit(node.m_value, slot);
+        if (node.m_operation != operation_t::minus) {
+            return value;
+        }
+        if (value.is_scalar()) {
+            return {nullptr, -value.m_scalar};
+        }
+        auto out = scratch(slot);
+        m_kernels.m_negate(out, value.m_data, m_count);
+        return {out, 0};
+    }
+
+    template<Node First, Node Second>
+    [[nodiscard]] lanes_t visit(const binary_t<First, Second> &node, const std::size_t slot) const {
+        auto first = visit(node.m_first, slot);
+        if constexpr (writes_state_v<Second>) {
+            // the second operand may overwrite a column the first one still points into
+            first = materialize(first, slot);
+        }
+        const auto second = visit(node.m_second, slot + 1);
+        if constexpr (Policy::checks_divisors) {
+            if (node.m_operation == operation_t::div) {
+                check_divisor(second);
+            }
+        }
+        if (first.is_scalar() && second.is_scalar()) {
+            return {nullptr, apply(node.m_operation, first.m_scalar, second.m_scalar)};
+        }
+
+        auto out = scratch(slot);
+        combine(node.m_operation, out, first, second);
+        return {out, 0};
+    }
+
+    [[nodiscard]] lanes_t visit(const variable_t &node, std::size_t) const noexcept {
+        return {m_batch.column(node).data() + m_offset, 0};
+    }
+
+    template<Node Second>
+    [[nodiscard]] lanes_t visit(const assign_t<Second> &node, const std::size_t slot) const {
+        const auto value = visit(node.m_second, slot);
+        auto variable = m_batch.column(node.m_first).data() + m_offset;
+        combine(node.m_operation, variable, {variable, 0}, value);
+        return {variable, 0};
+    }
+
+    [[nodiscard]] lanes_t visit(const constant_t &node, std::size_t) const noexcept {
+        return {nullptr, node.m_value};
+    }
+
+private:
+    [[nodiscard]] double *scratch(const std::size_t slot) const noexcept {
+        return m_scratch + slot * block_size;
+    }
+
+    [[nodiscard]] lanes_t materialize(const lanes_t &lanes, const std::size_t slot) const noexcept {
+        if (lanes.is_scalar() || lanes.m_data == scratch(slot)) {
+            return lanes;
+        }
+        auto out = scratch(slot);
+        combine(operation_t::assign, out, {out, 0}, lanes);
+        return {out, 0};
+    }
+
+    [[nodiscard]] static constexpr double apply(const operation_t operation, const double a, const double b) noexcept {
+        switch (operation) {
+            case operation_t::plus:
+                return a + b;
+            case operation_t::minus:
+                return a - b;
+            case operation_t::mul:
+                return a * b;
+            case operation_t::div:
+                return a / b;
+            default:
+                return b;
+        }
+    }
+
+    void check_divisor(const lanes_t &divisor) const {
+        m_policy.check(divisor.is_scalar() ? divisor.m_scalar == 0 : m_kernels.m_any_zero(divisor.m_data, m_count));
+    }
+
+    // At least one of `a` and `b` is a column; `out` may alias either of them.
+    void combine(const operation_t operation, double *out, const lanes_t &a, const lanes_t &b) const noexcept {
+        const auto index = static_cast<std::size_t>(operation);
+        if (a.is_scalar()) {
+            m_kernels.m_scalar_column[index](out, a.m_scalar, b.m_data, m_count);
+        } else if (b.is_scalar()) {
+            m_kernels.m_column_scalar[index](out, a.m_data, b.m_scalar, m_count);
+        } else {
+            m_kernels.m_column_column[index](out, a.m_data, b.m_data, m_count);
+        }
+    }
+};
+
+// Evaluates `node` for rows [first, last) of `batch`, writing row i's result to out[i]. Rows are independent, so
+// disjoint ranges may be evaluated concurrently.
+template<Node T, ErrorPolicy Policy = throw_on_error_t>
+void batch_eval_rows(const T &node, batch_t &batch, const std::span<double> out, const std::size_t first,
+                     const std::size_t last, const simd_kernels_t &kernels = simd_kernels(),
+                     const Policy &policy = {}) {
+    constexpr auto block_size = batch_eval_visitor_t<Policy>::block_size;
+    std::vector<double> scratch(std::max<std::size_t>(1, scratch_slots_v<T>) * block_size);
+    batch_eval_visitor_t visitor{batch, scratch.data(), kernels, policy};
+    for (std::size_t offset = first; offset < last; offset += block_size) {
+        visitor.m_offset = offset;
+        visitor.m_count = std::min(block_size, last - offset);
+        const auto result = visitor.visit(node.get(), 0);
+        for (std::size_t i = 0; i < visitor.m_count; ++i) {
+            out[offset + i] = result[i];
+        }
+    }
+}
+
+// Evaluates `node` once per row of `batch`, writing row i's result to out[i].
+template<Node T, ErrorPolicy Policy = throw_on_error_t>
+void batch_eval(const T &node, batch_t &batch, const std::span<double> out,
+                const simd_kernels_t &kernels = simd_kernels(), const Policy &policy = {}) {
+    if (out.size() < batch.rows()) {
+        throw std::length_error{"output column is shorter than the batch"};
+    }
+    batch_eval_rows(node, batch, out, 0, batch.rows(), kernels, policy);
+}
+
+template<Node T, ErrorPolicy Policy = throw_on_error_t>
+[[nodiscard]] std::vector<double> batch_eval(const T &node, batch_t &batch,
+                                             const simd_kernels_t &kernels = simd_kernels(),
+                                             const Policy &policy = {}) {
+    std::vector<double> out(batch.rows());
+    batch_eval(node, batch, out, kernels, policy);
+    return out;
+}
@@ -0,0 +1,670 @@
+#include "expr.hpp"
+#include "ast.hpp"
+#include "batch.hpp"
+#include "bytecode.hpp"
+#include "columnar.hpp"
+#include "cse.hpp"
+#include "csv.hpp"
+#include "gradient.hpp"
+#include "incremental.hpp"
+#include "jit.hpp"
+#include "parallel.hpp"
+#include "schedule.hpp"
+#include "simplify.hpp"
+#include "parser.hpp"
+#include "bench.hpp"
+
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+
+// Generates `count` random statements over `symbol_table`'s variables, one per line.
+static std::string generate_formulas(const symbol_table_t &symbol_table, const std::size_t count) {
+    std::mt19937 random{42};
+    const auto pick = [&](std::size_t n) { return std::uniform_int_distribution<std::size_t>{0, n - 1}(random); };
+    constexpr const char *operators[] = {"+", "-", "*", "/"};
+    constexpr const char *assignments[] = {"<<=", "+=", "-=", "*=", "/="};
+
+    std::string text;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (pick(2) == 0) {
+            text += symbol_table.name(pick(symbol_table.m_names.size()));
+            text += assignments[pick(5)];
+        }
+        const auto terms = 2 + pick(12);
+        for (std::size_t term = 0; term < terms; ++term) {
+            if (term != 0) {
+                text += operators[pick(4)];
+            }
+            if (pick(4) == 0) {
+                text += std::to_string(pick(1000)) + ".5";
+            } else {
+                text += symbol_table.name(pick(symbol_table.m_names.size()));
+            }
+        }
+        text += '\n';
+    }
+    return text;
+}
+
+// One evaluation of a single node through node_t::operator().
+template<Node T>
+static void bench_node(const bench_t &bench, const std::string &name, const T &node, state_t &state) {
+    bench.run("node/" + name, [&] {
+        do_not_optimize(node(state));
+    });
+}
+
+static void bench_nodes(const bench_t &bench) {
+    auto sys = symbol_table_t{};
+    const auto a = sys.variable("a", 1.5);
+    const auto b = sys.variable("b", 2.5);
+    // compound assignments multiply and divide by one so that repeating them keeps the state unchanged
+    const auto one = sys.variable("one", 1);
+    auto &state = sys.m_state;
+
+    bench_node(bench, "variable", a, state);
+    bench_node(bench, "constant", constant_t{2.5}, state);
+    bench_node(bench, "unary minus", -a, state);
+    bench_node(bench, "a+b", a + b, state);
+    bench_node(bench, "a-b", a - b, state);
+    bench_node(bench, "a*b", a * b, state);
+    bench_node(bench, "a/b", a / b, state);
+    bench_node(bench, "a<<=b", a <<= b, state);
+    bench_node(bench, "a+=one", a += one, state);
+    bench_node(bench, "a-=one", a -= one, state);
+    bench_node(bench, "a*=one", a *= one, state);
+    bench_node(bench, "a/=one", a /= one, state);
+}
+
+// A chain of Depth multiply-adds, each depending on the previous one.
+template<std::size_t Depth>
+static constexpr auto deep_tree(const variable_t &a, const variable_t &b) {
+    if constexpr (Depth == 0) {
+        return a;
+    } else {
+        return deep_tree<Depth - 1>(a, b) * b + a;
+    }
+}
+
+// A balanced tree with 2^Depth variable reads as leaves, alternating sums and products by level.
+template<std::size_t Depth, std::size_t Index = 0>
+static constexpr auto wide_tree(const std::array<variable_t, 8> &variables) {
+    if constexpr (Depth == 0) {
+        return variables[Index % variables.size()];
+    } else if constexpr (Depth % 2 == 0) {
+        return wide_tree<Depth - 1, 2 * Index>(variables) + wide_tree<Depth - 1, 2 * Index + 1>(variables);
+    } else {
+        return wide_tree<Depth - 1, 2 * Index>(variables) * wide_tree<Depth - 1, 2 * Index + 1>(variables);
+    }
+}
+
+// The same expression through every evaluator: templates, both ast_t walks, bytecode, native code and the batch path.
+template<Node T>
+static void bench_shape(const bench_t &bench, const std::string &name, const T &node, const symbol_table_t &sys) {
+    auto state = sys.m_state;
+    bench.run(name + "/template", [&] {
+        do_not_optimize(node(state));
+    });
+
+    const auto ast = to_ast(node);
+    bench.run(name + "/ast", [&] {
+        do_not_optimize(ast(state));
+    });
+    ast_evaluator_t evaluator;
+    bench.run(name + "/ast linear", [&] {
+        do_not_optimize(evaluator.run(ast, state));
+    });
+
+    const auto program = compile(node);
+    vm_t vm;
+    bench.run(name + "/bytecode", [&] {
+        do_not_optimize(vm.run(program, state));
+    });
+    jit_program_t native{program};
+    bench.run(name + (native.native() ? "/jit" : "/jit (interpreted)"), [&] {
+        do_not_optimize(native.run(state));
+    });
+
+    batch_t batch{sys, 4096};
+    std::vector<double> out(batch.rows());
+    bench.run(name + "/batch (per row)", [&] {
+        batch_eval(node, batch, out);
+        do_not_optimize(out.data());
+    }, batch.rows());
+    bench.run(name + "/batch ieee (per row)", [&] {
+        batch_eval(node, batch, out, simd_kernels(), ieee_errors_t{});
+        do_not_optimize(out.data());
+    }, batch.rows());
+}
+
+static void bench_shapes(const bench_t &bench) {
+    auto sys = symbol_table_t{};
+    const std::array variables{sys.variable("a", 0.5), sys.variable("b", 0.625), sys.variable("c", 0.75),
+                               sys.variable("d", 0.875), sys.variable("e", 1), sys.variable("f", 1.125),
+                               sys.variable("g", 1.25), sys.variable("h", 1.375)};
+    const auto &[a, b, c, d, e, f, g, h] = variables;
+
+    bench_shape(bench, "small", (a + b) * (c - d) / (e + 1.0), sys);
+    static_symbol_table_t<5> fixed{{"a", "b", "c", "d", "e"}, {0.5, 0.625, 0.75, 0.875, 1}};
+    auto fixed_state = fixed.m_state;
+    const auto small = (fixed.variable<0>() + fixed.variable<1>()) * (fixed.variable<2>() - fixed.variable<3>()) /
+                       (fixed.variable<4>() + 1.0);
+    bench.run("small/template static state", [&] {
+        do_not_optimize(small(fixed_state));
+    });
+    bench_shape(bench, "deep (32 levels)", deep_tree<32>(a, b), sys);
+    bench_shape(bench, "wide (64 leaves)", wide_tree<6>(variables), sys);
+}
+
+static void bench_parser(const bench_t &bench) {
+    auto sys = symbol_table_t{};
+    for (char name = 'a'; name <= 'z'; ++name) {
+        (void) sys.variable(std::string{"var_"} + name, 1);
+    }
+
+    const auto text = generate_formulas(sys, 100'000);
+    bench.run("parse/formula file (" + std::to_string(text.size() >> 20) + " MiB)", [&] {
+        const auto programs = parse_programs(text, sys);
+        do_not_optimize(programs.data());
+    }, 1, text.size());
+}
+
+// Resolving names in a 16k-variable table, through its hashed index and by scanning m_names, and copying the table.
+static void bench_symbols(const bench_t &bench) {
+    constexpr std::size_t variables = 16'384;
+    auto sys = symbol_table_t{};
+    for (std::size_t i = 0; i < variables; ++i) {
+        (void) sys.variable("sensor_" + std::to_string(i), 0);
+    }
+    std::mt19937 random{7};
+    std::vector<std::string> names;
+    for (std::size_t i = 0; i < 1024; ++i) {
+        names.emplace_back(sys.name(random() % variables));
+    }
+
+    bench.run("symbols/find in 16k names, hashed", [&] {
+        std::size_t sum = 0;
+        for (const auto &name: names) {
+            sum += sys.find(name);
+        }
+        do_not_optimize(sum);
+    }, names.size());
+    bench.run("symbols/find in 16k names, linear", [&] {
+        std::size_t sum = 0;
+        for (const auto &name: names) {
+            sum += static_cast<std::size_t>(std::ranges::find(sys.m_names, name) - sys.m_names.begin());
+        }
+        do_not_optimize(sum);
+    }, names.size());
+    bench.run("symbols/copy 16k-name table", [&] {
+        const auto copy = sys;
+        do_not_optimize(copy.m_names.data());
+    }, variables);
+}
+
+// The conventional alternative to ast_t: one heap allocation per node.
+struct pointer_node_t {
+    ast_kind_t m_kind;
+    operation_t m_operation;
+    double m_value;
+    std::size_t m_id;
+    std::unique_ptr<pointer_node_t> m_first;
+    std::unique_ptr<pointer_node_t> m_second;
+};
+
+struct pointer_tree_builder_t {
+    using handle_type = std::unique_ptr<pointer_node_t>;
+
+    handle_type constant(const double value) {
+        return std::make_unique<pointer_node_t>(
+                pointer_node_t{ast_kind_t::constant, operation_t::assign, value, 0, nullptr, nullptr});
+    }
+
+    handle_type variable(const std::size_t id) {
+        return std::make_unique<pointer_node_t>(
+                pointer_node_t{ast_kind_t::variable, operation_t::assign, 0, id, nullptr, nullptr});
+    }
+
+    handle_type binary(const operation_t operation, handle_type first, handle_type second) {
+        return std::make_unique<pointer_node_t>(
+                pointer_node_t{ast_kind_t::binary, operation, 0, 0, std::move(first), std::move(second)});
+    }
+};
+
+static double evaluate(const pointer_node_t &node, const state_t &state) {
+    switch (node.m_kind) {
+        case ast_kind_t::constant:
+            return node.m_value;
+        case ast_kind_t::variable:
+            return state[node.m_id];
+        default:
+            break;
+    }
+    const auto first = evaluate(*node.m_first, state);
+    const auto second = evaluate(*node.m_second, state);
+    switch (node.m_operation) {
+        case operation_t::plus:
+            return first + second;
+        case operation_t::minus:
+            return first - second;
+        case operation_t::mul:
+            return first * second;
+        default:
+            if (second == 0) {
+                throw std::logic_error{"division by zero"};
+            }
+            return first / second;
+    }
+}
+
+// Builds the same random binary tree with `leaves` leaves through any builder, so both layouts hold equal trees.
+template<typename Builder>
+static auto build_random_tree(Builder &builder, std::mt19937 &random, const std::size_t leaves,
+                              const std::size_t variables) {
+    if (leaves == 1) {
+        const auto leaf = random();
+        return leaf % 4 == 0 ? builder.constant(static_cast<double>(leaf % 100) + 0.5)
+                             : builder.variable(leaf % variables);
+    }
+    // no division, so every evaluation of the tree stays finite
+    const auto operation = static_cast<operation_t>(1 + random() % 3);
+    const auto left = 1 + random() % (leaves - 1);
+    auto first = build_random_tree(builder, random, left, variables);
+    auto second = build_random_tree(builder, random, leaves - left, variables);
+    return builder.binary(operation, std::move(first), std::move(second));
+}
+
+static void bench_ast(const bench_t &bench) {
+    constexpr std::size_t leaves = 4096;
+    constexpr std::size_t nodes = 2 * leaves - 1;
+    state_t state(16, 1.5);
+
+    bench.run("ast/arena build+eval+free", [&] {
+        std::mt19937 random{7};
+        ast_t ast;
+        ast.m_root = build_random_tree(ast, random, leaves, state.size());
+        do_not_optimize(ast(state));
+    }, nodes);
+    bench.run("ast/unique_ptr build+eval+free", [&] {
+        std::mt19937 random{7};
+        pointer_tree_builder_t builder;
+        const auto root = build_random_tree(builder, random, leaves, state.size());
+        do_not_optimize(evaluate(*root, state));
+    }, nodes);
+
+    std::mt19937 random{7};
+    ast_t ast;
+    ast.m_root = build_random_tree(ast, random, leaves, state.size());
+    bench.run("ast/arena eval", [&] {
+        do_not_optimize(ast(state));
+    }, nodes);
+
+    random.seed(7);
+    pointer_tree_builder_t builder;
+    const auto root = build_random_tree(builder, random, leaves, state.size());
+    bench.run("ast/unique_ptr eval", [&] {
+        do_not_optimize(evaluate(*root, state));
+    }, nodes);
+}
+
+static void bench_cse(const bench_t &bench) {
+    auto sys = symbol_table_t{};
+    for (char name = 'a'; name <= 'h'; ++name) {
+        (void) sys.variable(std::string{name}, 1.5);
+    }
+    // the shape template-generated formulas have: the same few subtrees over and over
+    std::string text = "(a*b+c*d)*(e-f)";
+    for (int i = 0; i < 6; ++i) {
+        text = "(" + text + ")*(a*b+c*d)+(" + text + ")/(e-f+g*h)";
+    }
+    const auto tree = parse_ast(text, sys);
+    cse_pass_t pass;
+    const auto dag = pass.run(tree);
+    std::printf("cse: %zu of %zu nodes deduplicated\n", pass.m_stats.deduplicated(), pass.m_stats.m_nodes_before);
+
+    auto state = sys.m_state;
+    ast_evaluator_t evaluator;
+    bench.run("cse/tree eval", [&] {
+        do_not_optimize(evaluator.run(tree, state));
+    });
+    bench.run("cse/dag eval", [&] {
+        do_not_optimize(evaluator.run(dag, state));
+    });
+    vm_t vm;
+    const auto tree_program = compile(tree);
+    const auto dag_program = compile(dag);
+    bench.run("cse/tree bytecode", [&] {
+        do_not_optimize(vm.run(tree_program, state));
+    });
+    bench.run("cse/dag bytecode", [&] {
+        do_not_optimize(vm.run(dag_program, state));
+    });
+}
+
+static void bench_simplify(const bench_t &bench) {
+    auto sys = symbol_table_t{};
+    for (char name = 'a'; name <= 'h'; ++name) {
+        (void) sys.variable(std::string{name}, 1.5);
+    }
+    // generated formulas: unit factors, double negations and zero terms around the real arithmetic
+    std::string text = "a";
+    for (int i = 0; i < 64; ++i) {
+        const std::string x(1, static_cast<char>('a' + i % 8));
+        const std::string y(1, static_cast<char>('a' + (i + 3) % 8));
+        text = "(" + text + ")*1+-(-(" + x + "*" + y + "/2))-" + x + "*0+(" + y + "-" + y + ")";
+    }
+    const auto tree = parse_ast(text, sys);
+    for (const bool fast_math: {false, true}) {
+        simplify_pass_t pass{{fast_math}};
+        const auto simplified = pass.run(tree);
+        std::printf("simplify%s: %zu nodes to %zu\n", fast_math ? " (fast math)" : "", pass.m_stats.m_nodes_before,
+                    pass.m_stats.m_nodes_after);
+
+        auto state = sys.m_state;
+        ast_evaluator_t evaluator;
+        const auto program = compile(simplified);
+        vm_t vm;
+        const std::string name = fast_math ? "simplify/fast math" : "simplify/exact";
+        bench.run(name + " ast eval", [&] {
+            do_not_optimize(evaluator.run(simplified, state));
+        });
+        bench.run(name + " bytecode", [&] {
+            do_not_optimize(vm.run(program, state));
+        });
+    }
+
+    auto state = sys.m_state;
+    ast_evaluator_t evaluator;
+    const auto program = compile(tree);
+    vm_t vm;
+    bench.run("simplify/original ast eval", [&] {
+        do_not_optimize(evaluator.run(tree, state));
+    });
+    bench.run("simplify/original bytecode", [&] {
+        do_not_optimize(vm.run(program, state));
+    });
+}
+
+static void bench_gradient(const bench_t &bench) {
+    auto sys = symbol_table_t{};
+    for (std::size_t i = 0; i < 256; ++i) {
+        (void) sys.variable("x" + std::to_string(i), 1.0 + static_cast<double>(i) / 256);
+    }
+    // a sum of products over every variable
+    std::string text;
+    for (std::size_t i = 0; i < 256; ++i) {
+        text += (i == 0 ? "" : "+") + std::string{sys.name(i)} + "*" + std::string{sys.name((i * 7 + 3) % 256)} + "/" +
+                std::string{sys.name((i + 1) % 256)};
+    }
+    const auto ast = parse_ast(text, sys);
+    auto state = sys.m_state;
+    gradient_tape_t tape;
+    std::vector<double> gradient;
+    bench.run("gradient/reverse 256 variables", [&] {
+        do_not_optimize(tape.run(ast, state, gradient));
+    });
+    ast_evaluator_t evaluator;
+    bench.run("gradient/value only", [&] {
+        do_not_optimize(evaluator.run(ast, state));
+    });
+}
+
+static void bench_incremental(const bench_t &bench) {
+    auto sys = symbol_table_t{};
+    for (std::size_t i = 0; i < 64; ++i) {
+        (void) sys.variable("p" + std::to_string(i), 1.0 + static_cast<double>(i) / 64);
+    }
+    // a pricing loop: many stored formulas, each over a few of the variables, one variable changing per step
+    std::mt19937 random{11};
+    std::vector<ast_t> formulas;
+    for (std::size_t i = 0; i < 500; ++i) {
+        ast_t ast;
+        ast.m_root = build_random_tree(ast, random, 16, 8);
+        // shift the 8 variables each formula reads to a window of the 64
+        for (auto &node: ast.m_nodes) {
+            if (node.m_kind == ast_kind_t::variable) {
+                node.m_first = static_cast<std::uint32_t>((node.m_first + i) % 64);
+            }
+        }
+        formulas.push_back(std::move(ast));
+    }
+
+    incremental_engine_t engine{sys};
+    std::vector<incremental_engine_t::handle_type> handles;
+    for (const auto &formula: formulas) {
+        handles.push_back(engine.add(formula));
+    }
+    std::size_t step = 0;
+    bench.run("incremental/500 formulas, one change", [&] {
+        ++step;
+        engine.set(variable_t{step % 64}, static_cast<double>(step % 7));
+        for (const auto handle: handles) {
+            do_not_optimize(engine.value(handle));
+        }
+    });
+
+    auto state = sys.m_state;
+    ast_evaluator_t evaluator;
+    bench.run("incremental/500 formulas, full re-evaluation", [&] {
+        ++step;
+        state[step % 64] = static_cast<double>(step % 7);
+        for (const auto &formula: formulas) {
+            do_not_optimize(evaluator.run(formula, state));
+        }
+    });
+}
+
+static void bench_schedule(const bench_t &bench) {
+    auto sys = symbol_table_t{};
+    for (char name = 'a'; name <= 'z'; ++name) {
+        (void) sys.variable(std::string{"var_"} + name, 1);
+    }
+    std::vector<ast_t> statements;
+    std::mt19937 random{3};
+    for (std::size_t i = 0; i < 200; ++i) {
+        const auto name = [&] { return std::string{sys.name(random() % sys.m_names.size())}; };
+        statements.push_back(parse_ast(name() + "<<=" + name() + "*0.5+" + name() + "-" + name(), sys));
+    }
+
+    auto state = sys.m_state;
+    std::vector<program_t> programs;
+    for (const auto &statement: statements) {
+        programs.push_back(compile(statement));
+    }
+    vm_t vm;
+    bench.run("schedule/200 statements, one program each", [&] {
+        for (const auto &program: programs) {
+            do_not_optimize(vm.run(program, state));
+        }
+    });
+
+    auto program = schedule(statements);
+    std::printf("schedule: %zu statements in %zu waves\n", statements.size(), program.m_waves.size());
+    bench.run("schedule/200 statements, scheduled program", [&] {
+        do_not_optimize(program.run(state));
+    });
+}
+
+// A balanced tree with 2^Depth leaves alternating between two variables and between + and *.
+template<std::size_t Depth, std::size_t Index = 0>
+static auto balanced_tree(const variable_t &a, const variable_t &b) {
+    if constexpr (Depth == 0) {
+        return Index % 2 == 0 ? a : b;
+    } else if constexpr (Depth % 2 == 0) {
+        return balanced_tree<Depth - 1, 2 * Index>(a, b) + balanced_tree<Depth - 1, 2 * Index + 1>(a, b);
+    } else {
+        return balanced_tree<Depth - 1, 2 * Index>(a, b) * balanced_tree<Depth - 1, 2 * Index + 1>(a, b);
+    }
+}
+
+static void bench_parallel(const bench_t &bench) {
+    thread_pool_t pool;
+    std::printf("parallel: %zu worker threads\n", pool.size());
+
+    // 64 independent statements of about 2000 nodes each: one wave
+    auto sys = symbol_table_t{};
+    for (std::size_t i = 0; i < 128; ++i) {
+        (void) sys.variable("v" + std::to_string(i), 1.0 / static_cast<double>(i + 1));
+    }
+    std::vector<ast_t> statements;
+    for (std::size_t i = 0; i < 64; ++i) {
+        std::string text = std::string{sys.name(i)} + "<<=" + std::string{sys.name(64 + i)};
+        for (std::size_t term = 0; term < 500; ++term) {
+            text += (term % 2 == 0 ? "+" : "-") + std::string{sys.name(64 + (i + term) % 64)} + "*0.5";
+        }
+        statements.push_back(parse_ast(text, sys));
+    }
+    auto program = schedule(statements);
+    auto state = sys.m_state;
+    bench.run("parallel/64 wide statements, one thread", [&] {
+        do_not_optimize(program.run(state));
+    }, statements.size());
+    bench.run("parallel/64 wide statements, thread pool", [&] {
+        do_not_optimize(program.run(state, pool));
+    }, statements.size());
+
+    auto tree_sys = symbol_table_t{};
+    const auto a = tree_sys.variable("a", 1);
+    const auto b = tree_sys.variable("b", 1);
+    const auto tree = balanced_tree<12>(a, b);
+    auto &tree_state = tree_sys.m_state;
+    constexpr auto nodes = node_count_v<std::remove_cvref_t<decltype(tree)>>;
+    bench.run("parallel/8191-node tree, one thread", [&] {
+        do_not_optimize(tree(tree_state));
+    }, nodes);
+    bench.run("parallel/8191-node tree, thread pool", [&] {
+        do_not_optimize(parallel_eval(tree, tree_state, pool, 1024));
+    }, nodes);
+}
+
+// Parallel batch evaluation over 4M rows with 1, 2, 4, ... threads up to every hardware thread. A pool of n - 1
+// workers runs n threads, since the caller works too. The batch is refilled on each pool so its pages are placed
+// by the threads that use them.
+static void bench_parallel_batch(const bench_t &bench) {
+    auto sys = symbol_table_t{};
+    const auto a = sys.variable("a", 1.5);
+    const auto b = sys.variable("b", 2);
+    const auto c = sys.variable("c", 3);
+    const auto expr = (a + b) * c - a / (c + 1);
+    constexpr std::size_t rows = std::size_t{1} << 22;
+    std::vector<double> out(rows);
+
+    const auto hardware = std::max(1u, std::thread::hardware_concurrency());
+    for (std::size_t threads = 1;; threads = std::min<std::size_t>(threads * 2, hardware)) {
+        thread_pool_t pool{threads - 1};
+        auto batch = make_batch(sys, rows, pool);
+        bench.run("parallel batch/4M rows, " + std::to_string(threads) + " threads", [&] {
+            parallel_batch_eval(expr, batch, out, pool);
+            do_not_optimize(out.data());
+        }, rows, rows * 4 * sizeof(double));
+        if (threads == hardware) {
+            break;
+        }
+    }
+}
+
+// Streams a 2M-row file of three columns from the temporary directory through the batched evaluator.
+static void bench_stream(const bench_t &bench) {
+    auto sys = symbol_table_t{};
+    const auto a = sys.variable("a", 0);
+    const auto b = sys.variable("b", 0);
+    const auto c = sys.variable("c", 0);
+    constexpr std::size_t rows = std::size_t{1} << 21;
+    const auto directory = std::filesystem::temp_directory_path();
+    const auto input_path = directory / "dsl2_bench_stream_in.bin";
+    const auto output_path = directory / "dsl2_bench_stream_out.bin";
+    {
+        column_file_writer_t writer{input_path, {"a", "b", "c"}, rows};
+        std::vector<double> column(rows);
+        for (std::size_t id = 0; id < 3; ++id) {
+            for (std::size_t i = 0; i < rows; ++i) {
+                column[i] = static_cast<double>(i % 1000 + id + 1);
+            }
+            writer.append(column);
+        }
+        writer.finish();
+    }
+
+    const column_file_t input{input_path};
+    const auto expr = (a + b) * c - a / c;
+    for (const std::size_t chunk_rows: {std::size_t{1} << 12, stream_chunk_rows, std::size_t{1} << 20}) {
+        bench.run("stream/2M rows, chunks of " + std::to_string(chunk_rows), [&] {
+            do_not_optimize(stream_eval(expr, sys, input, output_path, "result", chunk_rows));
+        }, rows, rows * 4 * sizeof(double));
+    }
+    std::filesystem::remove(input_path);
+    std::filesystem::remove(output_path);
+}
+
+// CSV ingestion of 1M rows of four columns, one of them skipped, against reading the same file with iostreams.
+static void bench_csv(const bench_t &bench) {
+    auto sys = symbol_table_t{};
+    for (const auto *name: {"open", "high", "low"}) {
+        (void) sys.variable(name, 0);
+    }
+    constexpr std::size_t rows = std::size_t{1} << 20;
+    const auto path = std::filesystem::temp_directory_path() / "dsl2_bench.csv";
+    {
+        std::ofstream out{path};
+        out << "open,high,low,volume\n";
+        std::mt19937 random{5};
+        std::uniform_real_distribution<double> price{10, 1000};
+        for (std::size_t row = 0; row < rows; ++row) {
+            out << price(random) << ',' << price(random) << ',' << price(random) << ',' << random() % 100000 << '\n';
+        }
+    }
+    const auto size = static_cast<std::size_t>(std::filesystem::file_size(path));
+
+    bench.run("csv/1M rows mmap + from_chars", [&] {
+        const auto batch = read_csv(path, sys);
+        do_not_optimize(batch.m_data.data());
+    }, rows, size);
+    bench.run("csv/1M rows iostream", [&] {
+        batch_t batch{sys, rows};
+        std::ifstream in{path};
+        std::string line;
+        std::getline(in, line);
+        for (std::size_t row = 0; row < rows && std::getline(in, line); ++row) {
+            std::istringstream fields{line};
+            char comma;
+            double volume;
+            fields >> batch.column(0)[row] >> comma >> batch.column(1)[row] >> comma >> batch.column(2)[row] >> comma >>
+                   volume;
+        }
+        do_not_optimize(batch.m_data.data());
+    }, rows, size);
+    std::filesystem::remove(path);
+}
+
+int main(int argc, char **argv) {
+    bench_t bench;
+    if (argc > 1) {
+        bench.m_filter = argv[1];
+    }
+#ifndef __OPTIMIZE__
+    std::printf("warning: benchmarks built without optimisation\n");
+#endif
+
+    bench.header();
+    bench_nodes(bench);
+    bench_shapes(bench);
+    bench_parser(bench);
+    bench_symbols(bench);
+    bench_ast(bench);
+    bench_cse(bench);
+    bench_simplify(bench);
+    bench_gradient(bench);
+    bench_incremental(bench);
+    bench_schedule(bench);
+    bench_parallel(bench);
+    bench_parallel_batch(bench);
+    bench_stream(bench);
+    bench_csv(bench);
+}
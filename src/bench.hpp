@@ -0,0 +1,254 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Keeps the optimiser from discarding a value computed only to be measured.
+template<typename T>
+inline void do_not_optimize(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const T *sink;
+    sink = &value;
+#endif
+}
+
+enum class perf_counter_t : std::size_t {
+    cycles,
+    instructions,
+    branch_misses,
+    l1d_misses,
+    llc_misses,
+};
+
+inline constexpr std::size_t perf_counter_count = 5;
+
+using perf_values_t = std::array<std::uint64_t, perf_counter_count>;
+
+/*
+ * Hardware counters for the user-space execution of this thread and of every thread it starts afterwards (thread
+ * pools included), read through perf_event_open. Inherited counters cannot be read as a group, so each counter is
+ * opened on its own and, if the kernel multiplexes it, scaled up to the full measured time by itself. Each counter
+ * the kernel refuses (no PMU in a VM, perf_event_paranoid, seccomp in a container, ...) is left out and reads as
+ * zero; when none can be opened nothing is measured.
+ */
+struct perf_counters_t {
+    // -1 for counters that could not be opened
+    std::array<int, perf_counter_count> m_fds{-1, -1, -1, -1, -1};
+
+    perf_counters_t() {
+#if defined(__linux__)
+        constexpr std::uint64_t l1d_read_miss = PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                                                PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+        constexpr std::array<std::pair<std::uint32_t, std::uint64_t>, perf_counter_count> events{{
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+                {PERF_TYPE_HW_CACHE, l1d_read_miss},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        }};
+        for (std::size_t i = 0; i < perf_counter_count; ++i) {
+            perf_event_attr attributes{};
+            attributes.type = events[i].first;
+            attributes.size = sizeof(attributes);
+            attributes.config = events[i].second;
+            attributes.disabled = 1;
+            attributes.inherit = 1;
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+            attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            m_fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+        }
+#endif
+    }
+
+    perf_counters_t(const perf_counters_t &) = delete;
+    perf_counters_t &operator=(const perf_counters_t &) = delete;
+
+    ~perf_counters_t() {
+#if defined(__linux__)
+        for (const auto fd: m_fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    [[nodiscard]] bool available() const noexcept {
+        return std::any_of(m_fds.begin(), m_fds.end(), [](const int fd) { return fd >= 0; });
+    }
+
+    [[nodiscard]] bool available(const perf_counter_t counter) const noexcept {
+        return m_fds[static_cast<std::size_t>(counter)] >= 0;
+    }
+
+    void start() const noexcept {
+#if defined(__linux__)
+        for (const auto fd: m_fds) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    [[nodiscard]] perf_values_t stop() const noexcept {
+        perf_values_t values{};
+#if defined(__linux__)
+        for (const auto fd: m_fds) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+        for (std::size_t i = 0; i < perf_counter_count; ++i) {
+            // value, time enabled, time running; the value sums this thread and the threads it started
+            std::array<std::uint64_t, 3> buffer{};
+            if (m_fds[i] < 0 || read(m_fds[i], buffer.data(), sizeof(buffer)) <= 0 || buffer[2] == 0) {
+                continue;
+            }
+            const auto scale = static_cast<double>(buffer[1]) / static_cast<double>(buffer[2]);
+            values[i] = static_cast<std::uint64_t>(static_cast<double>(buffer[0]) * scale);
+        }
+#endif
+        return values;
+    }
+};
+
+struct bench_result_t {
+    std::string m_name;
+    // number of calls to the measured function and how many items (evaluations, rows, ...) each call covers
+    std::size_t m_iterations = 0;
+    std::size_t m_items_per_iteration = 1;
+    std::size_t m_bytes_per_iteration = 0;
+    double m_seconds = 0;
+    // hardware counter totals over all iterations, and which of them could be measured at all
+    perf_values_t m_counters{};
+    std::array<bool, perf_counter_count> m_counted{};
+
+    [[nodiscard]] double items() const noexcept {
+        return static_cast<double>(m_iterations) * static_cast<double>(m_items_per_iteration);
+    }
+
+    [[nodiscard]] double ns_per_item() const noexcept {
+        return m_seconds * 1e9 / items();
+    }
+
+    [[nodiscard]] double items_per_second() const noexcept {
+        return items() / m_seconds;
+    }
+
+    [[nodiscard]] double megabytes_per_second() const noexcept {
+        return static_cast<double>(m_iterations) * static_cast<double>(m_bytes_per_iteration) / m_seconds / 1e6;
+    }
+
+    [[nodiscard]] bool counted(const perf_counter_t counter) const noexcept {
+        return m_counted[static_cast<std::size_t>(counter)];
+    }
+
+    [[nodiscard]] double per_item(const perf_counter_t counter) const noexcept {
+        return static_cast<double>(m_counters[static_cast<std::size_t>(counter)]) / items();
+    }
+
+    // instructions per cycle
+    [[nodiscard]] double ipc() const noexcept {
+        return per_item(perf_counter_t::instructions) / per_item(perf_counter_t::cycles);
+    }
+};
+
+struct bench_t {
+    std::chrono::duration<double> m_min_time{0.2};
+    std::string_view m_filter;
+    perf_counters_t m_counters;
+
+    // Calls `function` until `m_min_time` has elapsed and prints one report line.
+    template<typename Function>
+    bench_result_t run(std::string name, Function &&function, const std::size_t items_per_iteration = 1,
+                       const std::size_t bytes_per_iteration = 0) const {
+        bench_result_t result{std::move(name), 0, items_per_iteration, bytes_per_iteration};
+        if (!m_filter.empty() && result.m_name.find(m_filter) == std::string::npos) {
+            return result;
+        }
+        for (std::size_t i = 0; i < perf_counter_count; ++i) {
+            result.m_counted[i] = m_counters.available(static_cast<perf_counter_t>(i));
+        }
+
+        using clock = std::chrono::steady_clock;
+        // warm caches and branch predictors before timing
+        function();
+
+        std::size_t batch = 1;
+        for (;;) {
+            const auto start = clock::now();
+            m_counters.start();
+            for (std::size_t i = 0; i < batch; ++i) {
+                function();
+            }
+            const auto counters = m_counters.stop();
+            const std::chrono::duration<double> elapsed = clock::now() - start;
+            for (std::size_t i = 0; i < perf_counter_count; ++i) {
+                result.m_counters[i] += counters[i];
+            }
+            result.m_iterations += batch;
+            result.m_seconds += elapsed.count();
+            if (result.m_seconds >= m_min_time.count()) {
+                break;
+            }
+            batch *= 2;
+        }
+
+        report(result);
+        return result;
+    }
+
+    // An item is one evaluation unless the benchmark says otherwise (rows of a batch, nodes of a tree, ...).
+    // Counter columns are per item.
+    void header() const {
+        std::printf("%-44s %11s %13s %10s %10s %5s %9s %9s %9s %9s\n", "benchmark", "ns/item", "items/s",
+                    "cycles", "instr", "IPC", "br-miss", "L1D-miss", "LLC-miss", "MB/s");
+        if (!m_counters.available()) {
+            std::printf("(hardware counters unavailable)\n");
+        }
+    }
+
+    static void report(const bench_result_t &result) {
+        std::printf("%-44s %11.2f %13.0f", result.m_name.c_str(), result.ns_per_item(), result.items_per_second());
+        const auto column = [&result](const perf_counter_t counter, const int width, const int precision) {
+            if (result.counted(counter)) {
+                std::printf(" %*.*f", width, precision, result.per_item(counter));
+            } else {
+                std::printf(" %*s", width, "-");
+            }
+        };
+        column(perf_counter_t::cycles, 10, 1);
+        column(perf_counter_t::instructions, 10, 1);
+        if (result.counted(perf_counter_t::cycles) && result.counted(perf_counter_t::instructions)) {
+            std::printf(" %5.2f", result.ipc());
+        } else {
+            std::printf(" %5s", "-");
+        }
+        column(perf_counter_t::branch_misses, 9, 3);
+        column(perf_counter_t::l1d_misses, 9, 3);
+        column(perf_counter_t::llc_misses, 9, 3);
+        if (result.m_bytes_per_iteration != 0) {
+            std::printf(" %9.1f", result.megabytes_per_second());
+        }
+        std::printf("\n");
+    }
+};
@@ -0,0 +1,365 @@
+#pragma once
+
+#include "expr.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+enum class opcode_t : std::uint8_t {
+    load_variable,
+    load_constant,
+    negate,
+    add,
+    sub,
+    mul,
+    div,
+    // store_* follow the order of operation_t so that `store_assign + operation` selects the compound store
+    store_assign,
+    store_add,
+    store_sub,
+    store_mul,
+    store_div,
+    ret,
+};
+
+// Three-address instruction; operands are registers unless the opcode says otherwise.
+struct instruction_t {
+    opcode_t m_opcode;
+    // load_*, negate, arithmetic and store_*: destination register
+    std::uint32_t m_target;
+    // load_variable/store_*: variable id, load_constant: constant index, otherwise: register
+    std::uint32_t m_first;
+    std::uint32_t m_second;
+
+    constexpr bool operator==(const instruction_t &) const noexcept = default;
+};
+
+// A linear program: evaluation needs no template instantiation, so it can be cached or shipped elsewhere.
+struct program_t {
+    std::vector<instruction_t> m_code;
+    std::vector<double> m_constants;
+    std::uint32_t m_registers = 0;
+    // number of state entries the program touches (one past the largest variable id)
+    std::uint32_t m_variables = 0;
+
+    constexpr bool operator==(const program_t &) const noexcept = default;
+};
+
+[[nodiscard]] constexpr opcode_t arithmetic_opcode(const operation_t operation) {
+    switch (operation) {
+        case operation_t::plus:
+            return opcode_t::add;
+        case operation_t::minus:
+            return opcode_t::sub;
+        case operation_t::mul:
+            return opcode_t::mul;
+        case operation_t::div:
+            return opcode_t::div;
+        default:
+            throw std::logic_error{"not an arithmetic operation"};
+    }
+}
+
+[[nodiscard]] constexpr opcode_t store_opcode(const operation_t operation) noexcept {
+    return static_cast<opcode_t>(static_cast<std::uint8_t>(opcode_t::store_assign) +
+                                 static_cast<std::uint8_t>(operation));
+}
+
+// Builds a program bottom-up; registers are allocated as a stack, so a node's result lands in the lowest free one.
+struct program_builder_t {
+    program_t m_program;
+
+    constexpr std::uint32_t constant(const std::uint32_t target, const double value) {
+        auto &constants = m_program.m_constants;
+        const auto found = std::ranges::find_if(constants, [value](double c) {
+            return std::bit_cast<std::uint64_t>(c) == std::bit_cast<std::uint64_t>(value);
+        });
+        const auto index = static_cast<std::uint32_t>(found - constants.begin());
+        if (found == constants.end()) {
+            constants.push_back(value);
+        }
+        return emit(opcode_t::load_constant, target, index, 0);
+    }
+
+    constexpr std::uint32_t variable(const std::uint32_t target, const std::size_t id) {
+        return emit(opcode_t::load_variable, target, use_variable(id), 0);
+    }
+
+    constexpr std::uint32_t unary(const operation_t operation, const std::uint32_t value) {
+        return unary(operation, value, value);
+    }
+
+    constexpr std::uint32_t unary(const operation_t operation, const std::uint32_t target, const std::uint32_t value) {
+        if (operation == operation_t::minus) {
+            return emit(opcode_t::negate, target, value, 0);
+        }
+        return value;
+    }
+
+    constexpr std::uint32_t binary(const operation_t operation, const std::uint32_t first, const std::uint32_t second) {
+        return binary(operation, first, first, second);
+    }
+
+    constexpr std::uint32_t binary(const operation_t operation, const std::uint32_t target, const std::uint32_t first,
+                                   const std::uint32_t second) {
+        return emit(arithmetic_opcode(operation), target, first, second);
+    }
+
+    constexpr std::uint32_t assign(const operation_t operation, const std::size_t id, const std::uint32_t value) {
+        return assign(operation, value, id, value);
+    }
+
+    constexpr std::uint32_t assign(const operation_t operation, const std::uint32_t target, const std::size_t id,
+                                   const std::uint32_t value) {
+        return emit(store_opcode(operation), target, use_variable(id), value);
+    }
+
+    constexpr program_t finish(const std::uint32_t result) {
+        emit(opcode_t::ret, result, 0, 0);
+        return std::move(m_program);
+    }
+
+private:
+    constexpr std::uint32_t use_variable(const std::size_t id) {
+        m_program.m_variables = std::max(m_program.m_variables, static_cast<std::uint32_t>(id + 1));
+        return static_cast<std::uint32_t>(id);
+    }
+
+    constexpr std::uint32_t emit(const opcode_t opcode, const std::uint32_t target, const std::uint32_t first,
+                                 const std::uint32_t second) {
+        m_program.m_code.push_back({opcode, target, first, second});
+        m_program.m_registers = std::max(m_program.m_registers, target + 1);
+        return target;
+    }
+};
+
+struct compile_visitor_t {
+    program_builder_t &m_builder;
+
+    constexpr explicit compile_visitor_t(program_builder_t &builder) : m_builder(builder) {}
+
+    template<Node T>
+    constexpr std::uint32_t visit(const unary_t<T> &node, const std::uint32_t target) const {
+        return m_builder.unary(node.m_operation, visit(node.m_value, target));
+    }
+
+    template<Node First, Node Second>
+    constexpr std::uint32_t visit(const binary_t<First, Second> &node, const std::uint32_t target) const {
+        const auto first = visit(node.m_first, target);
+        const auto second = visit(node.m_second, target + 1);
+        return m_builder.binary(node.m_operation, first, second);
+    }
+
+    constexpr std::uint32_t visit(const variable_t &node, const std::uint32_t target) const {
+        return m_builder.variable(target, node.m_id);
+    }
+
+    template<Node Second>
+    constexpr std::uint32_t visit(const assign_t<Second> &node, const std::uint32_t target) const {
+        return m_builder.assign(node.m_operation, node.m_first.m_id, visit(node.m_second, target));
+    }
+
+    constexpr std::uint32_t visit(const constant_t &node, const std::uint32_t target) const {
+        return m_builder.constant(target, node.m_value);
+    }
+};
+
+// Lowers an expression template into bytecode.
+template<Node T>
+[[nodiscard]] constexpr program_t compile(const T &node) {
+    program_builder_t builder;
+    compile_visitor_t visitor{builder};
+    return builder.finish(visitor.visit(node.get(), 0));
+}
+
+#ifndef DSL2_COMPUTED_GOTO
+#if defined(__GNUC__) || defined(__clang__)
+#define DSL2_COMPUTED_GOTO 1
+#else
+#define DSL2_COMPUTED_GOTO 0
+#endif
+#endif
+
+// Register machine executing a program_t; keeps its register file between runs so steady state does not allocate.
+struct vm_t {
+    std::vector<double> m_registers;
+
+    double run(const program_t &program, state_t &state) {
+        if (state.size() < program.m_variables) {
+            throw std::out_of_range{"state is smaller than the program's variables"};
+        }
+        if (m_registers.size() < program.m_registers) {
+            m_registers.resize(program.m_registers);
+        }
+
+        auto *const r = m_registers.data();
+        auto *const s = state.data();
+        const auto *const c = program.m_constants.data();
+        const auto *ip = program.m_code.data();
+
+#if DSL2_COMPUTED_GOTO
+        // must list the labels in opcode_t order
+        static const void *const dispatch[] = {
+                &&load_variable, &&load_constant, &&negate, &&add, &&sub, &&mul, &&div,
+                &&store_assign, &&store_add, &&store_sub, &&store_mul, &&store_div, &&ret,
+        };
+#define DSL2_VM_CASE(name) name:
+#define DSL2_VM_NEXT() goto *dispatch[static_cast<std::size_t>((++ip)->m_opcode)]
+        goto *dispatch[static_cast<std::size_t>(ip->m_opcode)];
+#else
+#define DSL2_VM_CASE(name) case opcode_t::name:
+#define DSL2_VM_NEXT() ++ip; continue
+        for (;;) switch (ip->m_opcode) {
+#endif
+        DSL2_VM_CASE(load_variable)
+        r[ip->m_target] = s[ip->m_first];
+        DSL2_VM_NEXT();
+        DSL2_VM_CASE(load_constant)
+        r[ip->m_target] = c[ip->m_first];
+        DSL2_VM_NEXT();
+        DSL2_VM_CASE(negate)
+        r[ip->m_target] = -r[ip->m_first];
+        DSL2_VM_NEXT();
+        DSL2_VM_CASE(add)
+        r[ip->m_target] = r[ip->m_first] + r[ip->m_second];
+        DSL2_VM_NEXT();
+        DSL2_VM_CASE(sub)
+        r[ip->m_target] = r[ip->m_first] - r[ip->m_second];
+        DSL2_VM_NEXT();
+        DSL2_VM_CASE(mul)
+        r[ip->m_target] = r[ip->m_first] * r[ip->m_second];
+        DSL2_VM_NEXT();
+        DSL2_VM_CASE(div)
+        if (r[ip->m_second] == 0) {
+            throw std::logic_error{"division by zero"};
+        }
+        r[ip->m_target] = r[ip->m_first] / r[ip->m_second];
+        DSL2_VM_NEXT();
+        DSL2_VM_CASE(store_assign)
+        r[ip->m_target] = s[ip->m_first] = r[ip->m_second];
+        DSL2_VM_NEXT();
+        DSL2_VM_CASE(store_add)
+        r[ip->m_target] = s[ip->m_first] += r[ip->m_second];
+        DSL2_VM_NEXT();
+        DSL2_VM_CASE(store_sub)
+        r[ip->m_target] = s[ip->m_first] -= r[ip->m_second];
+        DSL2_VM_NEXT();
+        DSL2_VM_CASE(store_mul)
+        r[ip->m_target] = s[ip->m_first] *= r[ip->m_second];
+        DSL2_VM_NEXT();
+        DSL2_VM_CASE(store_div)
+        r[ip->m_target] = s[ip->m_first] /= r[ip->m_second];
+        DSL2_VM_NEXT();
+        DSL2_VM_CASE(ret)
+        return r[ip->m_target];
+#if !DSL2_COMPUTED_GOTO
+        }
+#endif
+#undef DSL2_VM_CASE
+#undef DSL2_VM_NEXT
+    }
+};
+
+inline double run(const program_t &program, state_t &state) {
+    vm_t vm;
+    return vm.run(program, state);
+}
+
+// Serialised layout: magic, register and variable counts, constants, then the code, all in host byte order.
+inline constexpr char program_magic[4] = {'D', 'S', 'L', '2'};
+
+template<typename T>
+void write_raw(std::ostream &out, const T &value) {
+    out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template<typename T>
+[[nodiscard]] T read_raw(std::istream &in) {
+    T value;
+    if (!in.read(reinterpret_cast<char *>(&value), sizeof(T))) {
+        throw std::runtime_error{"truncated program"};
+    }
+    return value;
+}
+
+inline void serialize(std::ostream &out, const program_t &program) {
+    out.write(program_magic, sizeof(program_magic));
+    write_raw(out, program.m_registers);
+    write_raw(out, program.m_variables);
+    write_raw(out, static_cast<std::uint64_t>(program.m_constants.size()));
+    for (const auto constant: program.m_constants) {
+        write_raw(out, constant);
+    }
+    write_raw(out, static_cast<std::uint64_t>(program.m_code.size()));
+    for (const auto &instruction: program.m_code) {
+        write_raw(out, instruction.m_opcode);
+        write_raw(out, instruction.m_target);
+        write_raw(out, instruction.m_first);
+        write_raw(out, instruction.m_second);
+    }
+}
+
+// Rejects anything the VM could not run safely: unknown opcodes, out-of-range operands, or a missing `ret`.
+[[nodiscard]] inline program_t deserialize(std::istream &in) {
+    char magic[sizeof(program_magic)];
+    if (!in.read(magic, sizeof(magic)) || !std::ranges::equal(magic, program_magic)) {
+        throw std::runtime_error{"not a program"};
+    }
+
+    program_t program;
+    program.m_registers = read_raw<std::uint32_t>(in);
+    program.m_variables = read_raw<std::uint32_t>(in);
+    // the counts are untrusted, so records are appended as they are read rather than allocated up front
+    const auto constants = read_raw<std::uint64_t>(in);
+    for (std::uint64_t i = 0; i < constants; ++i) {
+        program.m_constants.push_back(read_raw<double>(in));
+    }
+    const auto instructions = read_raw<std::uint64_t>(in);
+    for (std::uint64_t i = 0; i < instructions; ++i) {
+        instruction_t instruction{};
+        instruction.m_opcode = read_raw<opcode_t>(in);
+        instruction.m_target = read_raw<std::uint32_t>(in);
+        instruction.m_first = read_raw<std::uint32_t>(in);
+        instruction.m_second = read_raw<std::uint32_t>(in);
+        program.m_code.push_back(instruction);
+    }
+
+    const auto malformed = [&program](const instruction_t &instruction) {
+        const auto is_register = [&program](std::uint32_t r) { return r < program.m_registers; };
+        switch (instruction.m_opcode) {
+            case opcode_t::load_variable:
+                return !is_register(instruction.m_target) || instruction.m_first >= program.m_variables;
+            case opcode_t::load_constant:
+                return !is_register(instruction.m_target) || instruction.m_first >= program.m_constants.size();
+            case opcode_t::negate:
+                return !is_register(instruction.m_target) || !is_register(instruction.m_first);
+            case opcode_t::add:
+            case opcode_t::sub:
+            case opcode_t::mul:
+            case opcode_t::div:
+                return !is_register(instruction.m_target) || !is_register(instruction.m_first) ||
+                       !is_register(instruction.m_second);
+            case opcode_t::store_assign:
+            case opcode_t::store_add:
+            case opcode_t::store_sub:
+            case opcode_t::store_mul:
+            case opcode_t::store_div:
+                return !is_register(instruction.m_target) || instruction.m_first >= program.m_variables ||
+                       !is_register(instruction.m_second);
+            case opcode_t::ret:
+                return !is_register(instruction.m_target);
+        }
+        return true;
+    };
+    // every register is the target of some instruction, and vm_t allocates m_registers of them
+    if (program.m_code.empty() || program.m_code.back().m_opcode != opcode_t::ret ||
+        program.m_registers > program.m_code.size() || std::ranges::any_of(program.m_code, malformed)) {
+        throw std::runtime_error{"malformed program"};
+    }
+    return program;
+}
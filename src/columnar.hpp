@@ -0,0 +1,213 @@
+#pragma once
+
+#include "expr.hpp"
+#include "batch.hpp"
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Columnar file layout, in host byte order:
+ *
+ *     magic "DSLC", uint32 column count, uint64 row count
+ *     per column: uint32 name length, name bytes
+ *     zero padding up to a multiple of column_file_alignment
+ *     per column, in header order: row count doubles
+ *
+ * Each column is contiguous, so reading a range of rows of a few columns touches only those pages.
+ */
+inline constexpr char column_file_magic[4] = {'D', 'S', 'L', 'C'};
+inline constexpr std::size_t column_file_alignment = 64;
+
+// Read-only view of a columnar file through a memory mapping; nothing is loaded up front.
+struct column_file_t {
+    static constexpr auto npos = ~std::size_t{0};
+
+    explicit column_file_t(const std::filesystem::path &path) : m_file(path) {
+        const auto bytes = m_file.view();
+        std::size_t position = 0;
+        const auto read = [&](void *out, const std::size_t size) {
+            if (bytes.size() - position < size) {
+                throw std::runtime_error{"truncated column file"};
+            }
+            std::memcpy(out, bytes.data() + position, size);
+            position += size;
+        };
+
+        if (!bytes.starts_with(std::string_view{column_file_magic, sizeof(column_file_magic)})) {
+            throw std::runtime_error{"not a column file"};
+        }
+        position = sizeof(column_file_magic);
+        std::uint32_t columns;
+        read(&columns, sizeof(columns));
+        read(&m_rows, sizeof(m_rows));
+        m_names.reserve(columns);
+        for (std::uint32_t column = 0; column < columns; ++column) {
+            std::uint32_t length;
+            read(&length, sizeof(length));
+            if (bytes.size() - position < length) {
+                throw std::runtime_error{"truncated column file"};
+            }
+            m_names.push_back(bytes.substr(position, length));
+            position += length;
+        }
+        m_data_offset = (position + column_file_alignment - 1) / column_file_alignment * column_file_alignment;
+        if (m_rows > (bytes.size() - std::min(bytes.size(), m_data_offset)) / sizeof(double) / std::max(columns, 1u)) {
+            throw std::runtime_error{"truncated column file"};
+        }
+    }
+
+    [[nodiscard]] std::size_t rows() const noexcept {
+        return m_rows;
+    }
+
+    [[nodiscard]] std::size_t columns() const noexcept {
+        return m_names.size();
+    }
+
+    [[nodiscard]] std::string_view name(const std::size_t column) const noexcept {
+        return m_names[column];
+    }
+
+    // Index of the column called `name`, or npos.
+    [[nodiscard]] std::size_t find(const std::string_view name) const noexcept {
+        const auto found = std::ranges::find(m_names, name);
+        return found == m_names.end() ? npos : static_cast<std::size_t>(found - m_names.begin());
+    }
+
+    // Copies rows [first_row, first_row + out.size()) of a column into `out`.
+    void read(const std::size_t column, const std::size_t first_row, const std::span<double> out) const {
+        if (column >= columns() || first_row > m_rows || out.size() > m_rows - first_row) {
+            throw std::out_of_range{"rows outside the column file"};
+        }
+        std::memcpy(out.data(), m_file.data() + offset(column, first_row), out.size_bytes());
+    }
+
+    // Lets the kernel drop rows [first_row, first_row + count) of every column from memory.
+    void release(const std::size_t first_row, const std::size_t count) const noexcept {
+        for (std::size_t column = 0; column < columns(); ++column) {
+            m_file.release(offset(column, first_row), count * sizeof(double));
+        }
+    }
+
+private:
+    mapped_file_t m_file;
+    std::uint64_t m_rows = 0;
+    // views into the mapping
+    std::vector<std::string_view> m_names;
+    std::size_t m_data_offset = 0;
+
+    [[nodiscard]] std::size_t offset(const std::size_t column, const std::size_t row) const noexcept {
+        return m_data_offset + (column * m_rows + row) * sizeof(double);
+    }
+};
+
+// Writes a columnar file front to back: the header first, then append() the values of each column in turn.
+struct column_file_writer_t {
+    column_file_writer_t(const std::filesystem::path &path, const std::vector<std::string> &names,
+                         const std::size_t rows) : m_out(path, std::ios::binary), m_values(names.size() * rows) {
+        if (!m_out) {
+            throw std::runtime_error{"cannot create " + path.string()};
+        }
+        const auto write = [this](const void *data, const std::size_t size) {
+            m_out.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+        };
+        write(column_file_magic, sizeof(column_file_magic));
+        const auto columns = static_cast<std::uint32_t>(names.size());
+        const auto row_count = static_cast<std::uint64_t>(rows);
+        write(&columns, sizeof(columns));
+        write(&row_count, sizeof(row_count));
+        std::size_t position = sizeof(column_file_magic) + sizeof(columns) + sizeof(row_count);
+        for (const auto &name: names) {
+            const auto length = static_cast<std::uint32_t>(name.size());
+            write(&length, sizeof(length));
+            write(name.data(), name.size());
+            position += sizeof(length) + name.size();
+        }
+        const char padding[column_file_alignment]{};
+        write(padding, (column_file_alignment - position % column_file_alignment) % column_file_alignment);
+    }
+
+    void append(const std::span<const double> values) {
+        if (values.size() > m_values) {
+            throw std::length_error{"more values than the column file holds"};
+        }
+        m_out.write(reinterpret_cast<const char *>(values.data()), static_cast<std::streamsize>(values.size_bytes()));
+        m_values -= values.size();
+    }
+
+    // Checks that every value was written and flushes the file.
+    void finish() {
+        if (m_values != 0) {
+            throw std::length_error{"column file is missing values"};
+        }
+        m_out.flush();
+        if (!m_out) {
+            throw std::runtime_error{"cannot write column file"};
+        }
+    }
+
+private:
+    std::ofstream m_out;
+    // values still to be appended
+    std::size_t m_values;
+};
+
+// Rows per chunk for streaming evaluation; memory use is about (variables + 1) * 8 bytes per row of a chunk.
+inline constexpr std::size_t stream_chunk_rows = std::size_t{1} << 16;
+
+/*
+ * Evaluates `node` once per row of `input` and writes the results as a single-column file named `result_name`.
+ * Each variable of the symbol table reads the input column of the same name, or its initial value in every row
+ * when the input has no such column; other input columns are ignored. Rows are processed `chunk_rows` at a time
+ * through batch_eval() and released from memory afterwards, so memory use does not grow with the input.
+ * Assignments only affect the chunk being evaluated; the input file is never written. Returns the number of rows.
+ */
+template<Node T, ErrorPolicy Policy = throw_on_error_t>
+std::size_t stream_eval(const T &node, const symbol_table_t &symbol_table, const column_file_t &input,
+                        const std::filesystem::path &output, const std::string &result_name = "result",
+                        const std::size_t chunk_rows = stream_chunk_rows,
+                        const simd_kernels_t &kernels = simd_kernels(), const Policy &policy = {}) {
+    if (chunk_rows == 0) {
+        throw std::invalid_argument{"empty chunks"};
+    }
+    const auto rows = input.rows();
+    std::vector<std::size_t> sources(symbol_table.m_names.size());
+    for (std::size_t id = 0; id < sources.size(); ++id) {
+        sources[id] = input.find(symbol_table.name(id));
+    }
+
+    column_file_writer_t writer{output, {result_name}, rows};
+    batch_t batch{symbol_table, std::min(chunk_rows, rows)};
+    std::vector<double> out(batch.rows());
+    for (std::size_t first = 0; first < rows; first += chunk_rows) {
+        const auto count = std::min(chunk_rows, rows - first);
+        if (count != batch.rows()) {
+            batch = batch_t{symbol_table, count};
+        }
+        for (std::size_t id = 0; id < sources.size(); ++id) {
+            if (sources[id] != column_file_t::npos) {
+                input.read(sources[id], first, batch.column(id));
+            } else {
+                // an assignment in the previous chunk may have overwritten it
+                std::ranges::fill(batch.column(id), symbol_table.m_state[id]);
+            }
+        }
+        const auto result = std::span{out}.first(count);
+        batch_eval(node, batch, result, kernels, policy);
+        writer.append(result);
+        input.release(first, count);
+    }
+    writer.finish();
+    return rows;
+}
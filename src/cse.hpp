@@ -0,0 +1,156 @@
+#pragma once
+
+#include "expr.hpp"
+#include "ast.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Whether two expression templates are the same tree: same node types, operations, variables and constants.
+template<Node A, Node B>
+[[nodiscard]] constexpr bool structurally_equal(const A &a, const B &b) noexcept {
+    if constexpr (!std::is_same_v<A, B>) {
+        return false;
+    } else if constexpr (std::is_same_v<A, constant_t>) {
+        return std::bit_cast<std::uint64_t>(a.m_value) == std::bit_cast<std::uint64_t>(b.m_value);
+    } else if constexpr (requires { a.m_id; }) {
+        return a.m_id == b.m_id;
+    } else if constexpr (requires { a.m_value; }) {
+        return a.m_operation == b.m_operation && structurally_equal(a.m_value, b.m_value);
+    } else if constexpr (requires { a.m_first.m_id; }) {
+        return a.m_operation == b.m_operation && a.m_first.m_id == b.m_first.m_id &&
+               structurally_equal(a.m_second, b.m_second);
+    } else {
+        return a.m_operation == b.m_operation && structurally_equal(a.m_first, b.m_first) &&
+               structurally_equal(a.m_second, b.m_second);
+    }
+}
+
+struct cse_stats_t {
+    // nodes reachable from the root before and after the pass
+    std::size_t m_nodes_before = 0;
+    std::size_t m_nodes_after = 0;
+
+    [[nodiscard]] constexpr std::size_t deduplicated() const noexcept {
+        return m_nodes_before - m_nodes_after;
+    }
+};
+
+/*
+ * Rebuilds an ast_t so that structurally equal subexpressions become one node with several parents. The result
+ * is a DAG: ast_evaluator_t and compile() compute every shared node once per evaluation.
+ *
+ * Reads of a variable are only merged while no assignment to it happens in between (in evaluation order), and
+ * assignments themselves are never merged, so the rewritten expression has the same effects and value.
+ */
+struct cse_pass_t {
+    cse_stats_t m_stats;
+
+    [[nodiscard]] ast_t run(const ast_t &ast) {
+        m_source = &ast;
+        m_result = ast_t{};
+        m_mapping.assign(ast.size(), unmapped);
+        m_nodes.clear();
+        m_generations.clear();
+
+        // the arena is in evaluation order (see ast_t), so one forward sweep rebuilds every node after its operands
+        // and sees assignments exactly when an evaluator would
+        const auto nodes = reachable(ast);
+        for (ast_t::index_type index = 0; index < ast.size(); ++index) {
+            if (nodes[index]) {
+                m_mapping[index] = rebuild(ast[index]);
+            }
+        }
+        m_result.m_root = m_mapping[ast.m_root];
+        m_stats.m_nodes_before += reachable_nodes(ast);
+        m_stats.m_nodes_after += m_result.size();
+        return std::move(m_result);
+    }
+
+private:
+    static constexpr auto unmapped = ~ast_t::index_type{0};
+
+    // A node of the result plus whatever makes it differ from structurally equal nodes that must stay apart.
+    struct key_t {
+        ast_node_t m_node;
+        std::uint64_t m_extra;
+
+        constexpr bool operator==(const key_t &) const noexcept = default;
+    };
+
+    struct key_hash_t {
+        std::size_t operator()(const key_t &key) const noexcept {
+            auto hash = static_cast<std::uint64_t>(key.m_node.m_kind) << 56 ^
+                        static_cast<std::uint64_t>(key.m_node.m_operation) << 48 ^
+                        static_cast<std::uint64_t>(key.m_node.m_first) << 24 ^ key.m_node.m_second;
+            hash ^= key.m_extra + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+            return static_cast<std::size_t>(hash * 0xff51afd7ed558ccd);
+        }
+    };
+
+    const ast_t *m_source = nullptr;
+    ast_t m_result;
+    std::vector<ast_t::index_type> m_mapping;
+    std::unordered_map<key_t, ast_t::index_type, key_hash_t> m_nodes;
+    // bumped by every assignment to a variable, so reads on either side of it get different keys
+    std::unordered_map<std::uint32_t, std::uint64_t> m_generations;
+
+    ast_t::index_type intern(const key_t &key, const double constant = 0) {
+        if (const auto found = m_nodes.find(key); found != m_nodes.end()) {
+            return found->second;
+        }
+        ast_t::index_type index;
+        switch (key.m_node.m_kind) {
+            case ast_kind_t::constant:
+                index = m_result.constant(constant);
+                break;
+            case ast_kind_t::variable:
+                index = m_result.variable(key.m_node.m_first);
+                break;
+            case ast_kind_t::unary:
+                index = m_result.unary(key.m_node.m_operation, key.m_node.m_first);
+                break;
+            default:
+                index = m_result.binary(key.m_node.m_operation, key.m_node.m_first, key.m_node.m_second);
+                break;
+        }
+        m_nodes.emplace(key, index);
+        return index;
+    }
+
+    ast_t::index_type rebuild(const ast_node_t &node) {
+        switch (node.m_kind) {
+            case ast_kind_t::constant: {
+                const auto value = m_source->constant_value(node);
+                return intern({{node.m_kind, operation_t::assign, 0, 0}, std::bit_cast<std::uint64_t>(value)}, value);
+            }
+            case ast_kind_t::variable:
+                return intern({node, m_generations[node.m_first]});
+            case ast_kind_t::unary:
+                return intern({{node.m_kind, node.m_operation, m_mapping[node.m_first], 0}, 0});
+            case ast_kind_t::binary:
+                return intern({{node.m_kind, node.m_operation, m_mapping[node.m_first], m_mapping[node.m_second]}, 0});
+            case ast_kind_t::assign: {
+                const auto result = m_result.assign(node.m_operation, node.m_first, m_mapping[node.m_second]);
+                ++m_generations[node.m_first];
+                return result;
+            }
+        }
+        return unmapped;
+    }
+};
+
+[[nodiscard]] inline ast_t eliminate_common_subexpressions(const ast_t &ast) {
+    cse_pass_t pass;
+    return pass.run(ast);
+}
+
+// Expression templates are deduplicated through their runtime form.
+template<Node T>
+[[nodiscard]] ast_t eliminate_common_subexpressions(const T &node) {
+    return eliminate_common_subexpressions(to_ast(node));
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "expr.hpp"
+#include "batch.hpp"
+#include "mapped_file.hpp"
+#include "parser.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstddef>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#if DSL2_SIMD_X86
+#include <emmintrin.h>
+#endif
+
+// First `a` or `b` in [first, last), or `last`; SSE2 compares 16 bytes per step.
+[[nodiscard]] inline const char *csv_find(const char *first, const char *const last, const char a,
+                                          const char b) noexcept {
+#if DSL2_SIMD_X86
+    const auto va = _mm_set1_epi8(a);
+    const auto vb = _mm_set1_epi8(b);
+    for (; last - first >= 16; first += 16) {
+        const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+        const auto mask = static_cast<unsigned>(_mm_movemask_epi8(
+                _mm_or_si128(_mm_cmpeq_epi8(bytes, va), _mm_cmpeq_epi8(bytes, vb))));
+        if (mask != 0) {
+            return first + std::countr_zero(mask);
+        }
+    }
+#endif
+    for (; first != last; ++first) {
+        if (*first == a || *first == b) {
+            return first;
+        }
+    }
+    return last;
+}
+
+// Number of occurrences of `c` in [first, last).
+[[nodiscard]] inline std::size_t csv_count(const char *first, const char *const last, const char c) noexcept {
+    std::size_t count = 0;
+#if DSL2_SIMD_X86
+    const auto vc = _mm_set1_epi8(c);
+    for (; last - first >= 16; first += 16) {
+        const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+        count += static_cast<std::size_t>(std::popcount(static_cast<unsigned>(
+                _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, vc)))));
+    }
+#endif
+    for (; first != last; ++first) {
+        count += *first == c;
+    }
+    return count;
+}
+
+// Whether a decimal number that std::from_chars found out of range overflowed rather than underflowed. Its value
+// is 0.d... * 10^exponent, where the digits start at the first nonzero one, so the sign of the exponent decides.
+[[nodiscard]] inline bool csv_overflows(const char *first, const char *const last) noexcept {
+    long exponent = 0;
+    bool significant = false;
+    for (; first != last && *first != '.' && *first != 'e' && *first != 'E'; ++first) {
+        significant = significant || (*first >= '1' && *first <= '9');
+        exponent += significant;
+    }
+    if (first != last && *first == '.') {
+        for (++first; !significant && first != last && *first != 'e' && *first != 'E'; ++first) {
+            significant = *first != '0';
+            exponent -= !significant;
+        }
+        while (first != last && *first != 'e' && *first != 'E') {
+            ++first;
+        }
+    }
+    if (first == last) {
+        return exponent > 0;
+    }
+    ++first;
+    const bool negative = *first == '-';
+    first += *first == '-' || *first == '+';
+    long power = 0;
+    for (; first != last; ++first) {
+        // saturates well past any exponent a double can reach, so it cannot overflow
+        power = std::min(power * 10 + (*first - '0'), 1'000'000L);
+    }
+    return exponent + (negative ? -power : power) > 0;
+}
+
+/*
+ * Reads CSV text straight into a batch: a header line of names, then one record of numbers per line. A column
+ * whose name is a variable of the symbol table fills that variable's batch column, other columns are skipped, and
+ * variables without a column keep their initial value in every row. Rows are counted in one vectorised pass over
+ * the newlines, so the batch is allocated once, and every number is converted in place by std::from_chars.
+ *
+ * Fields are separated by `delimiter`; lines end in "\n" or "\r\n". There is no quoting, and spaces are only
+ * allowed around numbers. Errors are parse_error with the byte offset of the problem.
+ */
+[[nodiscard]] inline batch_t parse_csv(const std::string_view text, const symbol_table_t &symbol_table,
+                                       const char delimiter = ',') {
+    const auto *const begin = text.data();
+    const auto *position = begin;
+    auto end = begin + text.size();
+    // trailing blank lines are not records
+    while (end != begin && (end[-1] == '\n' || end[-1] == '\r')) {
+        --end;
+    }
+    const auto offset = [begin](const char *at) { return static_cast<std::size_t>(at - begin); };
+    const auto line_end = [&end](const char *from) {
+        auto last = csv_find(from, end, '\n', '\n');
+        return last != from && last[-1] == '\r' ? last - 1 : last;
+    };
+
+    // header: variable id per column, or none for columns to skip
+    constexpr auto none = symbol_table_t::npos;
+    std::vector<std::size_t> columns;
+    std::vector<bool> seen(symbol_table.m_names.size());
+    const auto header_end = line_end(position);
+    if (position == header_end) {
+        throw parse_error{"missing header", 0};
+    }
+    for (;;) {
+        const auto field_end = csv_find(position, header_end, delimiter, delimiter);
+        auto name = std::string_view{position, static_cast<std::size_t>(field_end - position)};
+        while (!name.empty() && name.front() == ' ') {
+            name.remove_prefix(1);
+        }
+        while (!name.empty() && name.back() == ' ') {
+            name.remove_suffix(1);
+        }
+        const auto id = symbol_table.find(name);
+        if (id != symbol_table_t::npos) {
+            if (seen[id]) {
+                throw parse_error{"duplicate column '" + std::string{name} + "'", offset(position)};
+            }
+            seen[id] = true;
+        }
+        columns.push_back(id);
+        if (field_end == header_end) {
+            break;
+        }
+        position = field_end + 1;
+    }
+    position = header_end == end ? end : csv_find(header_end, end, '\n', '\n') + 1;
+
+    const auto rows = position >= end ? 0 : csv_count(position, end, '\n') + 1;
+    batch_t batch{symbol_table, rows};
+    for (std::size_t row = 0; row < rows; ++row) {
+        const auto record_end = line_end(position);
+        for (std::size_t column = 0; column < columns.size(); ++column) {
+            const auto *const field = position;
+            if (columns[column] == none) {
+                position = csv_find(position, record_end, delimiter, delimiter);
+            } else {
+                while (position != record_end && *position == ' ') {
+                    ++position;
+                }
+                // from_chars rejects a leading '+', which CSV writers sometimes emit, but not the '-' after it
+                if (position != record_end && *position == '+') {
+                    ++position;
+                    if (position != record_end && *position == '-') {
+                        throw parse_error{"expected a number", offset(field)};
+                    }
+                }
+                auto &value = batch.column(columns[column])[row];
+                const auto [parsed, error] = std::from_chars(position, record_end, value);
+                if (error == std::errc::result_out_of_range) {
+                    // from_chars leaves the value alone, so it is set to the infinity or zero it rounds to
+                    const bool negative = *position == '-';
+                    const auto magnitude = csv_overflows(position + negative, parsed)
+                                                   ? std::numeric_limits<double>::infinity()
+                                                   : 0.0;
+                    value = negative ? -magnitude : magnitude;
+                } else if (error != std::errc{}) {
+                    throw parse_error{"expected a number", offset(field)};
+                }
+                position = parsed;
+                while (position != record_end && *position == ' ') {
+                    ++position;
+                }
+            }
+            const auto last = column + 1 == columns.size();
+            if (last ? position != record_end : position == record_end || *position != delimiter) {
+                throw parse_error{last ? "too many fields" : "too few fields", offset(position)};
+            }
+            ++position;
+        }
+        // past "\r\n" as well as "\n"
+        position = record_end == end ? end : csv_find(record_end, end, '\n', '\n') + 1;
+    }
+    return batch;
+}
+
+// parse_csv() over a memory-mapped file, so the text is never copied.
+[[nodiscard]] inline batch_t read_csv(const std::filesystem::path &path, const symbol_table_t &symbol_table,
+                                      const char delimiter = ',') {
+    const mapped_file_t file{path};
+    return parse_csv(file.view(), symbol_table, delimiter);
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "expr.hpp"
+
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+// A value together with its derivatives with respect to N chosen variables.
+template<std::size_t N>
+struct dual_t {
+    double m_value = 0;
+    std::array<double, N> m_tangent{};
+
+    [[nodiscard]] constexpr double derivative(const std::size_t i = 0) const noexcept {
+        return m_tangent[i];
+    }
+
+    constexpr bool operator==(const dual_t &) const noexcept = default;
+};
+
+template<std::size_t N>
+[[nodiscard]] constexpr dual_t<N> operator-(const dual_t<N> &a) noexcept {
+    dual_t<N> result{-a.m_value};
+    for (std::size_t i = 0; i < N; ++i) {
+        result.m_tangent[i] = -a.m_tangent[i];
+    }
+    return result;
+}
+
+template<std::size_t N>
+[[nodiscard]] constexpr dual_t<N> operator+(const dual_t<N> &a, const dual_t<N> &b) noexcept {
+    dual_t<N> result{a.m_value + b.m_value};
+    for (std::size_t i = 0; i < N; ++i) {
+        result.m_tangent[i] = a.m_tangent[i] + b.m_tangent[i];
+    }
+    return result;
+}
+
+template<std::size_t N>
+[[nodiscard]] constexpr dual_t<N> operator-(const dual_t<N> &a, const dual_t<N> &b) noexcept {
+    dual_t<N> result{a.m_value - b.m_value};
+    for (std::size_t i = 0; i < N; ++i) {
+        result.m_tangent[i] = a.m_tangent[i] - b.m_tangent[i];
+    }
+    return result;
+}
+
+template<std::size_t N>
+[[nodiscard]] constexpr dual_t<N> operator*(const dual_t<N> &a, const dual_t<N> &b) noexcept {
+    dual_t<N> result{a.m_value * b.m_value};
+    for (std::size_t i = 0; i < N; ++i) {
+        result.m_tangent[i] = a.m_tangent[i] * b.m_value + a.m_value * b.m_tangent[i];
+    }
+    return result;
+}
+
+// (a/b)' = (a' - (a/b) b') / b
+template<std::size_t N>
+[[nodiscard]] constexpr dual_t<N> operator/(const dual_t<N> &a, const dual_t<N> &b) noexcept {
+    dual_t<N> result{a.m_value / b.m_value};
+    for (std::size_t i = 0; i < N; ++i) {
+        result.m_tangent[i] = (a.m_tangent[i] - result.m_value * b.m_tangent[i]) / b.m_value;
+    }
+    return result;
+}
+
+// Derivatives of every state entry; assignments update them alongside the state itself.
+template<std::size_t N>
+using tangent_state_t = std::vector<std::array<double, N>>;
+
+// Evaluates value and derivatives in one pass, with the same semantics as eval_visitor_t.
+template<std::size_t N>
+struct diff_visitor_t {
+    state_t &m_state;
+    tangent_state_t<N> &m_tangents;
+
+    constexpr diff_visitor_t(state_t &state, tangent_state_t<N> &tangents) : m_state(state), m_tangents(tangents) {}
+
+    template<Node T>
+    [[nodiscard]] constexpr dual_t<N> visit(const unary_t<T> &node) const {
+        const auto value = visit(node.m_value);
+        return node.m_operation == operation_t::minus ? -value : value;
+    }
+
+    // operands left to right, as in eval_visitor_t
+    template<Node First, Node Second>
+    [[nodiscard]] constexpr dual_t<N> visit(const binary_t<First, Second> &node) const {
+        const auto first = visit(node.m_first);
+        const auto second = visit(node.m_second);
+        switch (node.m_operation) {
+            case operation_t::plus:
+                return first + second;
+            case operation_t::minus:
+                return first - second;
+            case operation_t::mul:
+                return first * second;
+            case operation_t::div:
+                if (second.m_value == 0) {
+                    throw std::logic_error{"division by zero"};
+                }
+                return first / second;
+            default:
+                throw std::logic_error{"not an arithmetic operation"};
+        }
+    }
+
+    [[nodiscard]] constexpr dual_t<N> visit(const variable_t &node) const noexcept {
+        return {m_state[node.m_id], m_tangents[node.m_id]};
+    }
+
+    template<Node Second>
+    [[nodiscard]] constexpr dual_t<N> visit(const assign_t<Second> &node) const {
+        const auto value = visit(node.m_second);
+        dual_t<N> variable{m_state[node.m_first.m_id], m_tangents[node.m_first.m_id]};
+        switch (node.m_operation) {
+            case operation_t::assign:
+                variable = value;
+                break;
+            case operation_t::plus:
+                variable = variable + value;
+                break;
+            case operation_t::minus:
+                variable = variable - value;
+                break;
+            case operation_t::mul:
+                variable = variable * value;
+                break;
+            case operation_t::div:
+                variable = variable / value;
+                break;
+        }
+        m_state[node.m_first.m_id] = variable.m_value;
+        m_tangents[node.m_first.m_id] = variable.m_tangent;
+        return variable;
+    }
+
+    [[nodiscard]] constexpr dual_t<N> visit(const constant_t &node) const noexcept {
+        return {node.m_value};
+    }
+};
+
+// Tangents seeded so that derivative i is taken with respect to `wrt[i]`.
+template<std::size_t N>
+[[nodiscard]] constexpr tangent_state_t<N> seed_tangents(const state_t &state, const std::array<variable_t, N> &wrt) {
+    tangent_state_t<N> tangents(state.size());
+    for (std::size_t i = 0; i < N; ++i) {
+        tangents[wrt[i].m_id][i] = 1;
+    }
+    return tangents;
+}
+
+// Value of `node` and its partial derivatives with respect to each of `wrt`, from a single evaluation.
+template<Node T, std::size_t N>
+[[nodiscard]] constexpr dual_t<N> differentiate(const T &node, state_t &state, const std::array<variable_t, N> &wrt) {
+    auto tangents = seed_tangents(state, wrt);
+    diff_visitor_t<N> visitor{state, tangents};
+    return visitor.visit(node.get());
+}
+
+template<Node T>
+[[nodiscard]] constexpr dual_t<1> differentiate(const T &node, state_t &state, const variable_t &wrt) {
+    return differentiate(node, state, std::array{wrt});
+}
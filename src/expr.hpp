@@ -1,14 +1,21 @@
 #pragma once
 
+#include "string_arena.hpp"
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <ranges>
 #include <type_traits>
 #include <utility>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <stdexcept>
 #include <ostream>
 
-using state_t = std::vector<double>;
-
 enum class operation_t {
     assign,
     plus,
@@ -17,13 +24,89 @@ enum class operation_t {
     div,
 };
 
+// A type expressions can be evaluated in: float or double for throughput or precision, an integer or a fixed-point
+// class for exact arithmetic. Constants written as double literals are converted to it when evaluated.
+template<typename V>
+concept Numeric = std::regular<V> && std::constructible_from<V, double> && requires(V a, const V b) {
+    { -b } -> std::convertible_to<V>;
+    { a + b } -> std::convertible_to<V>;
+    { a - b } -> std::convertible_to<V>;
+    { a * b } -> std::convertible_to<V>;
+    { a / b } -> std::convertible_to<V>;
+    a += b;
+    a -= b;
+    a *= b;
+    a /= b;
+};
+
+template<Numeric V>
+using basic_state_t = std::vector<V>;
+
+using state_t = basic_state_t<double>;
+
+// Anything the evaluator can keep variables in: a contiguous range of values indexed by variable id, such as a
+// basic_state_t or the std::array of a static_symbol_table_t.
+template<typename S>
+concept State = std::ranges::contiguous_range<S> && Numeric<std::ranges::range_value_t<S>> &&
+                requires(S &state, const std::size_t id) {
+                    { state[id] } -> std::same_as<std::ranges::range_value_t<S> &>;
+                };
+
+/*
+ * What an evaluator does about a zero divisor in a binary division. Compound assignments never check and always
+ * follow IEEE semantics.
+ *
+ * throw_on_error_t: throw std::logic_error, as the evaluators always have.
+ * ieee_errors_t: do not look, and let inf/NaN propagate. The division needs no branch, so the batch path
+ *     divides whole columns without scanning them first.
+ * sticky_error_t: raise a caller-owned flag without a branch and keep going; the flag is checked once afterwards.
+ */
+template<typename T>
+concept ErrorPolicy = requires(const T &policy) {
+    { T::checks_divisors } -> std::convertible_to<bool>;
+    policy.check(false);
+};
+
+struct throw_on_error_t {
+    static constexpr bool checks_divisors = true;
+
+    constexpr void check(const bool division_by_zero) const {
+        if (division_by_zero) {
+            throw std::logic_error{"division by zero"};
+        }
+    }
+};
+
+struct ieee_errors_t {
+    static constexpr bool checks_divisors = false;
+
+    constexpr void check(bool) const noexcept {}
+};
+
+struct sticky_error_t {
+    static constexpr bool checks_divisors = true;
+
+    bool &m_error;
+
+    constexpr explicit sticky_error_t(bool &error) noexcept: m_error(error) {}
+
+    constexpr void check(const bool division_by_zero) const noexcept {
+        m_error |= division_by_zero;
+    }
+};
+
+// CRTP base of every expression node: dispatch is static, so nodes carry no vptr and stay trivially copyable.
 template<typename T>
 struct node_t {
-    [[nodiscard]] constexpr double operator()(state_t &state) const;
+    template<State S>
+    [[nodiscard]] constexpr std::ranges::range_value_t<S> operator()(S &state) const;
 
-    [[nodiscard]] constexpr virtual const T &get() const noexcept = 0;
+    template<State S, ErrorPolicy Policy>
+    [[nodiscard]] constexpr std::ranges::range_value_t<S> operator()(S &state, const Policy &policy) const;
 
-    constexpr virtual ~node_t() = default;
+    [[nodiscard]] constexpr const T &get() const noexcept {
+        return static_cast<const T &>(*this);
+    }
 };
 
 template<typename T>
@@ -37,10 +120,6 @@ struct unary_t final : node_t<unary_t<T>> {
     const value_type m_value;
 
     constexpr unary_t(const operation_t operation, const value_type &value) : m_operation(operation), m_value(value) {}
-
-    [[nodiscard]] constexpr const unary_t<T> &get() const noexcept override {
-        return *this;
-    }
 };
 
 template<Node First, Node Second>
@@ -55,19 +134,22 @@ struct binary_t final : node_t<binary_t<First, Second>> {
     constexpr binary_t(const operation_t operation, const First &first, const Second &second) : m_operation(operation),
                                                                                                 m_first(first),
                                                                                                 m_second(second) {}
-
-    [[nodiscard]] constexpr const binary_t<First, Second> &get() const noexcept override {
-        return *this;
-    }
 };
 
 struct variable_t final : node_t<variable_t> {
     const std::size_t m_id;
 
     constexpr explicit variable_t(const std::size_t id) noexcept: m_id(id) {}
+};
+
+// A variable whose id is part of its type, so evaluating it over a std::array state reads a constant offset. It
+// converts to variable_t wherever a visitor or an operator has no overload of its own.
+template<std::size_t Id>
+struct static_variable_t final : node_t<static_variable_t<Id>> {
+    static constexpr std::size_t m_id = Id;
 
-    [[nodiscard]] constexpr const variable_t &get() const noexcept override {
-        return *this;
+    constexpr operator variable_t() const noexcept {
+        return variable_t(Id);
     }
 };
 
@@ -81,45 +163,145 @@ struct assign_t final : node_t<assign_t<Second>> {
 
     constexpr assign_t(const operation_t operation, const variable_t &first, const second_type second) : m_operation(
             operation), m_first(first), m_second(second) {}
+};
 
-    [[nodiscard]] constexpr const assign_t<Second> &get() const noexcept override {
-        return *this;
+/*
+ * Variables by id, with their names and initial values, and an index from names back to ids. The index is an
+ * open-addressing table of (hash, id) slots with linear probing, kept at most half full, so find() costs one hash
+ * of the name and usually a single string comparison, and never allocates.
+ *
+ * The names live in a string_arena_t, packed into shared chunks, so m_names is a vector of views and copying the
+ * table, say for a per-thread state, copies no strings. A view from name() stays valid while the table or any copy
+ * of it exists.
+ */
+template<Numeric V>
+struct basic_symbol_table_t {
+    static constexpr std::size_t npos = ~std::size_t{0};
+
+    std::vector<std::string_view> m_names;
+    basic_state_t<V> m_state;
+
+    // A new variable; throws std::invalid_argument when the name is taken.
+    [[nodiscard]] variable_t variable(const std::string_view name, const V init) {
+        if (find(name) != npos) {
+            throw std::invalid_argument{"duplicate variable '" + std::string{name} + "'"};
+        }
+        return add(name, init);
     }
-};
 
-struct symbol_table_t {
-    std::vector<std::string> m_names;
-    state_t m_state;
+    // The variable called `name`, created with `init` if there is none yet.
+    [[nodiscard]] variable_t get_or_create(const std::string_view name, const V init) {
+        const auto id = find(name);
+        return id == npos ? add(name, init) : variable_t(id);
+    }
+
+    // The id of the variable called `name`, or npos.
+    [[nodiscard]] constexpr std::size_t find(const std::string_view name) const noexcept {
+        if (m_index.empty()) {
+            return npos;
+        }
+        const auto hash = hash_name(name);
+        const auto mask = m_index.size() - 1;
+        for (auto slot = static_cast<std::size_t>(hash) & mask;; slot = (slot + 1) & mask) {
+            const auto &entry = m_index[slot];
+            if (entry.m_id == npos) {
+                return npos;
+            }
+            if (entry.m_hash == hash && m_names[entry.m_id] == name) {
+                return entry.m_id;
+            }
+        }
+    }
+
+    [[nodiscard]] constexpr std::string_view name(const std::size_t id) const noexcept {
+        return m_names[id];
+    }
+
+private:
+    struct slot_t {
+        std::uint64_t m_hash = 0;
+        std::size_t m_id = npos;
+    };
+
+    std::vector<slot_t> m_index;
+    string_arena_t m_arena;
 
-    [[nodiscard]] constexpr variable_t variable(std::string name, const double init) {
+    // FNV-1a, which unlike std::hash can run in a constant expression.
+    [[nodiscard]] static constexpr std::uint64_t hash_name(const std::string_view name) noexcept {
+        std::uint64_t hash = 0xcbf29ce484222325;
+        for (const auto c: name) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3;
+        }
+        return hash;
+    }
+
+    constexpr void insert(const std::uint64_t hash, const std::size_t id) noexcept {
+        const auto mask = m_index.size() - 1;
+        auto slot = static_cast<std::size_t>(hash) & mask;
+        while (m_index[slot].m_id != npos) {
+            slot = (slot + 1) & mask;
+        }
+        m_index[slot] = {hash, id};
+    }
+
+    variable_t add(const std::string_view name, const V init) {
         const auto id = m_state.size();
-        m_names.push_back(std::move(name));
+        if (2 * (id + 1) > m_index.size()) {
+            auto index = std::exchange(m_index, std::vector<slot_t>(std::max<std::size_t>(16, 2 * m_index.size())));
+            for (const auto &entry: index) {
+                if (entry.m_id != npos) {
+                    insert(entry.m_hash, entry.m_id);
+                }
+            }
+        }
+        m_names.push_back(m_arena.store(name));
         m_state.push_back(init);
+        insert(hash_name(name), id);
         return variable_t(id);
     }
+};
+
+using symbol_table_t = basic_symbol_table_t<double>;
+
+// A symbol table whose N variables are fixed at compile time. Its state is a std::array, so a copy of it can live
+// on the stack, or in a constexpr evaluation, instead of on the heap.
+template<std::size_t N, Numeric V = double>
+struct static_symbol_table_t {
+    std::array<std::string_view, N> m_names;
+    std::array<V, N> m_state;
+
+    template<std::size_t Id> requires (Id < N)
+    [[nodiscard]] static constexpr static_variable_t<Id> variable() noexcept {
+        return {};
+    }
 
-    [[nodiscard]] constexpr const std::string &name(const std::size_t id) const noexcept {
+    [[nodiscard]] constexpr std::string_view name(const std::size_t id) const noexcept {
         return m_names[id];
     }
 };
 
-struct constant_t final : node_t<constant_t> {
-    const double m_value;
+template<Numeric V>
+struct basic_constant_t final : node_t<basic_constant_t<V>> {
+    using value_type = V;
 
-    constexpr constant_t(const double value) noexcept: m_value(value) {}
+    const value_type m_value;
 
-    [[nodiscard]] constexpr const constant_t &get() const noexcept override {
-        return *this;
-    }
+    constexpr basic_constant_t(const value_type value) noexcept: m_value(value) {}
 };
 
+using constant_t = basic_constant_t<double>;
+
+template<Numeric V = double, ErrorPolicy Policy = throw_on_error_t, State S = basic_state_t<V>>
 struct eval_visitor_t {
-    state_t &m_state;
+    static_assert(std::is_same_v<std::ranges::range_value_t<S>, V>);
+
+    S &m_state;
+    [[no_unique_address]] const Policy m_policy;
 
-    constexpr explicit eval_visitor_t(state_t &state) : m_state(state) {}
+    constexpr explicit eval_visitor_t(S &state, const Policy &policy = {}) : m_state(state), m_policy(policy) {}
 
     template<Node T>
-    [[nodiscard]] constexpr double visit(const unary_t<T> &node) const {
+    [[nodiscard]] constexpr V visit(const unary_t<T> &node) const {
         switch (node.m_operation) {
             case operation_t::plus:
                 return visit(node.m_value);
@@ -128,30 +310,40 @@ struct eval_visitor_t {
         }
     }
 
+    // Operands are evaluated left to right, so an assignment in either one is seen by everything after it; a
+    // division checks its divisor once both are known. Every other evaluator follows the same order.
     template<Node First, Node Second>
-    [[nodiscard]] constexpr double visit(const binary_t<First, Second> &node) const {
+    [[nodiscard]] constexpr V visit(const binary_t<First, Second> &node) const {
+        const auto first = visit(node.m_first);
+        const auto second = visit(node.m_second);
         switch (node.m_operation) {
             case operation_t::plus:
-                return visit(node.m_first) + visit(node.m_second);
+                return first + second;
             case operation_t::minus:
-                return visit(node.m_first) - visit(node.m_second);
+                return first - second;
             case operation_t::mul:
-                return visit(node.m_first) * visit(node.m_second);
+                return first * second;
             case operation_t::div:
-                auto second = visit(node.m_second);
-                if (second == 0) {
-                    throw std::logic_error{"division by zero"};
+                if constexpr (Policy::checks_divisors) {
+                    m_policy.check(second == V{});
                 }
-                return visit(node.m_first) / second;
+                return divide(first, second);
+            default:
+                throw std::logic_error{"not an arithmetic operation"};
         }
     }
 
-    [[nodiscard]] constexpr double visit(const variable_t &node) const noexcept {
+    [[nodiscard]] constexpr V visit(const variable_t &node) const noexcept {
         return m_state[node.m_id];
     }
 
+    template<std::size_t Id>
+    [[nodiscard]] constexpr V visit(const static_variable_t<Id> &) const noexcept {
+        return m_state[Id];
+    }
+
     template<Node Second>
-    [[nodiscard]] constexpr double visit(const assign_t<Second> &node) const {
+    [[nodiscard]] constexpr V visit(const assign_t<Second> &node) const {
         const auto value = visit(node.m_second);
         auto &variable = m_state[node.m_first.m_id];
         switch (node.m_operation) {
@@ -168,22 +360,41 @@ struct eval_visitor_t {
                 variable *= value;
                 break;
             case operation_t::div:
-                variable /= value;
+                variable = divide(variable, value);
                 break;
         }
         return variable;
     }
 
-    [[nodiscard]] constexpr double visit(const constant_t &node) const noexcept {
-        return node.m_value;
+    template<Numeric C>
+    [[nodiscard]] constexpr V visit(const basic_constant_t<C> &node) const noexcept {
+        return static_cast<V>(node.m_value);
+    }
+
+private:
+    // Integers have no inf or NaN: a zero divisor the policy lets through yields zero instead of undefined behaviour.
+    [[nodiscard]] static constexpr V divide(const V first, const V second) noexcept {
+        if constexpr (std::is_floating_point_v<V>) {
+            return first / second;
+        } else {
+            return second == V{} ? V{} : first / second;
+        }
     }
 };
 
+template<State S>
+eval_visitor_t(S &) -> eval_visitor_t<std::ranges::range_value_t<S>, throw_on_error_t, S>;
+
+template<State S, ErrorPolicy Policy>
+eval_visitor_t(S &, const Policy &) -> eval_visitor_t<std::ranges::range_value_t<S>, Policy, S>;
+
+template<Numeric V = double>
 struct print_visitor {
     std::ostream &m_out;
-    const symbol_table_t &m_symbol_table;
+    const basic_symbol_table_t<V> &m_symbol_table;
 
-    print_visitor(std::ostream &out, const symbol_table_t &symbol_table) : m_out(out), m_symbol_table(symbol_table) {}
+    print_visitor(std::ostream &out, const basic_symbol_table_t<V> &symbol_table) : m_out(out),
+                                                                                   m_symbol_table(symbol_table) {}
 
     template<Node T>
     void visit(const unary_t<T> &node) {
@@ -247,17 +458,18 @@ struct print_visitor {
         visit(node.m_second);
     }
 
-    void visit(const constant_t &node) {
+    template<Numeric C>
+    void visit(const basic_constant_t<C> &node) {
         m_out << node.m_value;
     }
 };
 
-template<Node T>
+template<Node T, Numeric V = double>
 struct printer {
-    const symbol_table_t &m_symbol_table;
+    const basic_symbol_table_t<V> &m_symbol_table;
     const T &m_node;
 
-    printer(const symbol_table_t &symbol_table, const T &node) : m_symbol_table(symbol_table), m_node(node) {}
+    printer(const basic_symbol_table_t<V> &symbol_table, const T &node) : m_symbol_table(symbol_table), m_node(node) {}
 
     friend std::ostream &operator<<(std::ostream &out, const printer &printer) {
         print_visitor visitor{out, printer.m_symbol_table};
@@ -281,6 +493,11 @@ constexpr binary_t<First, constant_t> operator+(const First &first, const consta
     return binary_t(operation_t::plus, first, second);
 }
 
+// Constant-only subtrees are folded when the expression is built.
+constexpr constant_t operator+(const constant_t &first, const constant_t &second) noexcept {
+    return first.m_value + second.m_value;
+}
+
 template<Node First, Node Second>
 constexpr binary_t<First, Second> operator-(const First &first, const Second &second) {
     return binary_t(operation_t::minus, first, second);
@@ -296,6 +513,10 @@ constexpr binary_t<First, constant_t> operator-(const First &first, const consta
     return binary_t(operation_t::minus, first, second);
 }
 
+constexpr constant_t operator-(const constant_t &first, const constant_t &second) noexcept {
+    return first.m_value - second.m_value;
+}
+
 template<Node First, Node Second>
 constexpr binary_t<First, Second> operator*(const First &first, const Second &second) {
     return binary_t(operation_t::mul, first, second);
@@ -311,6 +532,10 @@ constexpr binary_t<First, constant_t> operator*(const First &first, const consta
     return binary_t(operation_t::mul, first, second);
 }
 
+constexpr constant_t operator*(const constant_t &first, const constant_t &second) noexcept {
+    return first.m_value * second.m_value;
+}
+
 template<Node First, Node Second>
 constexpr binary_t<First, Second> operator/(const First &first, const Second &second) {
     return binary_t(operation_t::div, first, second);
@@ -326,13 +551,19 @@ constexpr binary_t<First, constant_t> operator/(const First &first, const consta
     return binary_t(operation_t::div, first, second);
 }
 
+// Folded with IEEE semantics: a zero divisor gives an infinity or NaN rather than throwing while the expression is
+// built. In a constant expression it is rejected by the compiler instead.
+constexpr constant_t operator/(const constant_t &first, const constant_t &second) noexcept {
+    return first.m_value / second.m_value;
+}
+
 template<Node T>
 constexpr unary_t<T> operator+(const T &node) {
     return unary_t(operation_t::plus, node);
 }
 
-constexpr unary_t<constant_t> operator+(const constant_t &node) {
-    return unary_t(operation_t::plus, node);
+constexpr constant_t operator+(const constant_t &node) noexcept {
+    return node;
 }
 
 template<Node T>
@@ -340,8 +571,8 @@ constexpr unary_t<T> operator-(const T &node) {
     return unary_t(operation_t::minus, node);
 }
 
-constexpr unary_t<constant_t> operator-(const constant_t &node) {
-    return unary_t(operation_t::minus, node);
+constexpr constant_t operator-(const constant_t &node) noexcept {
+    return -node.m_value;
 }
 
 template<Node Second>
@@ -390,7 +621,15 @@ constexpr assign_t<constant_t> operator/=(const variable_t &first, const constan
 }
 
 template<typename T>
-constexpr double node_t<T>::operator()(state_t &state) const {
+template<State S>
+constexpr std::ranges::range_value_t<S> node_t<T>::operator()(S &state) const {
     eval_visitor_t visitor{state};
     return visitor.visit(get());
 }
+
+template<typename T>
+template<State S, ErrorPolicy Policy>
+constexpr std::ranges::range_value_t<S> node_t<T>::operator()(S &state, const Policy &policy) const {
+    eval_visitor_t visitor{state, policy};
+    return visitor.visit(get());
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include "expr.hpp"
+#include "ast.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+/*
+ * Reverse-mode differentiation: one forward pass evaluates the expression like eval_visitor_t and records every
+ * arithmetic step with its local partial derivatives on a tape, then one backward sweep over the tape accumulates
+ * the adjoints. The cost is independent of the number of variables, unlike diff_visitor_t.
+ *
+ * The gradient is with respect to the state as it was before the evaluation; assignments inside the expression are
+ * followed, so a later read of an assigned variable depends on whatever was assigned to it. The tape and adjoint
+ * buffers are kept between calls, so once they have grown to fit an expression no further allocation happens.
+ */
+struct gradient_tape_t {
+    using index_type = std::uint32_t;
+
+    // value is independent of every variable, e.g. a constant
+    static constexpr auto none = std::numeric_limits<index_type>::max();
+
+    // One step: the tape index of up to two inputs and the partial derivative of the result with respect to each.
+    struct entry_t {
+        index_type m_first;
+        index_type m_second;
+        double m_first_partial;
+        double m_second_partial;
+    };
+
+    struct value_t {
+        double m_value;
+        index_type m_index;
+    };
+
+    std::vector<entry_t> m_entries;
+    std::vector<double> m_adjoints;
+    // tape index holding each variable's current value; the first state.size() entries are the inputs
+    std::vector<index_type> m_current;
+
+    // Evaluates `node`, stores d node / d state[i] in gradient[i] and returns the value.
+    template<Node T>
+    double run(const T &node, state_t &state, std::vector<double> &gradient) {
+        start(state);
+        const auto result = visit(node.get(), state);
+        backward(result.m_index, gradient);
+        return result.m_value;
+    }
+
+    // The same for a runtime expression. Nodes are recorded front to back, so a node shared by several parents
+    // (see cse.hpp) is recorded once; as with ast_evaluator_t, every node in the arena is assumed to be reachable.
+    double run(const ast_t &ast, state_t &state, std::vector<double> &gradient) {
+        start(state);
+        m_values.resize(std::max(m_values.size(), ast.size()));
+        auto *const values = m_values.data();
+        for (std::size_t index = 0; index < ast.size(); ++index) {
+            const auto &node = ast[static_cast<ast_t::index_type>(index)];
+            const auto operand = [values](const std::uint32_t i) { return values[i]; };
+            switch (node.m_kind) {
+                case ast_kind_t::constant:
+                    values[index] = {ast.constant_value(node), none};
+                    break;
+                case ast_kind_t::variable:
+                    values[index] = {state[node.m_first], m_current[node.m_first]};
+                    break;
+                case ast_kind_t::unary:
+                    values[index] = unary(node.m_operation, operand(node.m_first));
+                    break;
+                case ast_kind_t::binary:
+                    values[index] = binary(node.m_operation, operand(node.m_first), operand(node.m_second));
+                    break;
+                case ast_kind_t::assign:
+                    values[index] = assign(node.m_operation, state, node.m_first, operand(node.m_second));
+                    break;
+            }
+        }
+        const auto result = values[ast.m_root];
+        backward(result.m_index, gradient);
+        return result.m_value;
+    }
+
+private:
+    std::vector<value_t> m_values;
+
+    void start(const state_t &state) {
+        const auto variables = static_cast<index_type>(state.size());
+        m_entries.assign(variables, {none, none, 0, 0});
+        m_current.resize(variables);
+        for (index_type id = 0; id < variables; ++id) {
+            m_current[id] = id;
+        }
+    }
+
+    value_t record(const double value, const value_t &first, const double first_partial,
+                   const value_t &second = {0, none}, const double second_partial = 0) {
+        if (first.m_index == none && second.m_index == none) {
+            return {value, none};
+        }
+        m_entries.push_back({first.m_index, second.m_index, first_partial, second_partial});
+        return {value, static_cast<index_type>(m_entries.size() - 1)};
+    }
+
+    void backward(const index_type root, std::vector<double> &gradient) {
+        const auto variables = m_current.size();
+        gradient.assign(variables, 0);
+        if (root == none) {
+            return;
+        }
+        m_adjoints.assign(m_entries.size(), 0);
+        auto *const adjoints = m_adjoints.data();
+        adjoints[root] = 1;
+        for (auto index = root + std::size_t{1}; index-- > variables;) {
+            const auto &entry = m_entries[index];
+            const auto adjoint = adjoints[index];
+            if (entry.m_first != none) {
+                adjoints[entry.m_first] += adjoint * entry.m_first_partial;
+            }
+            if (entry.m_second != none) {
+                adjoints[entry.m_second] += adjoint * entry.m_second_partial;
+            }
+        }
+        for (std::size_t id = 0; id < variables; ++id) {
+            gradient[id] = adjoints[id];
+        }
+    }
+
+    value_t unary(const operation_t operation, const value_t &value) {
+        return operation == operation_t::minus ? record(-value.m_value, value, -1) : value;
+    }
+
+    value_t binary(const operation_t operation, const value_t &first, const value_t &second) {
+        switch (operation) {
+            case operation_t::plus:
+                return record(first.m_value + second.m_value, first, 1, second, 1);
+            case operation_t::minus:
+                return record(first.m_value - second.m_value, first, 1, second, -1);
+            case operation_t::mul:
+                return record(first.m_value * second.m_value, first, second.m_value, second, first.m_value);
+            case operation_t::div: {
+                if (second.m_value == 0) {
+                    throw std::logic_error{"division by zero"};
+                }
+                const auto value = first.m_value / second.m_value;
+                return record(value, first, 1 / second.m_value, second, -value / second.m_value);
+            }
+            default:
+                throw std::logic_error{"not an arithmetic operation"};
+        }
+    }
+
+    value_t assign(const operation_t operation, state_t &state, const std::size_t id, const value_t &value) {
+        const value_t variable{state[id], m_current[id]};
+        value_t result;
+        switch (operation) {
+            case operation_t::assign:
+                result = value;
+                break;
+            case operation_t::plus:
+                result = record(variable.m_value + value.m_value, variable, 1, value, 1);
+                break;
+            case operation_t::minus:
+                result = record(variable.m_value - value.m_value, variable, 1, value, -1);
+                break;
+            case operation_t::mul:
+                result = record(variable.m_value * value.m_value, variable, value.m_value, value, variable.m_value);
+                break;
+            case operation_t::div: {
+                const auto quotient = variable.m_value / value.m_value;
+                result = record(quotient, variable, 1 / value.m_value, value, -quotient / value.m_value);
+                break;
+            }
+        }
+        state[id] = result.m_value;
+        m_current[id] = result.m_index;
+        return result;
+    }
+
+    template<Node T>
+    value_t visit(const unary_t<T> &node, state_t &state) {
+        return unary(node.m_operation, visit(node.m_value, state));
+    }
+
+    template<Node First, Node Second>
+    value_t visit(const binary_t<First, Second> &node, state_t &state) {
+        // operands left to right, as in eval_visitor_t
+        const auto first = visit(node.m_first, state);
+        const auto second = visit(node.m_second, state);
+        if (node.m_operation == operation_t::div && second.m_value == 0) {
+            throw std::logic_error{"division by zero"};
+        }
+        return binary(node.m_operation, first, second);
+    }
+
+    value_t visit(const variable_t &node, const state_t &state) const noexcept {
+        return {state[node.m_id], m_current[node.m_id]};
+    }
+
+    template<Node Second>
+    value_t visit(const assign_t<Second> &node, state_t &state) {
+        return assign(node.m_operation, state, node.m_first.m_id, visit(node.m_second, state));
+    }
+
+    static value_t visit(const constant_t &node, const state_t &) noexcept {
+        return {node.m_value, none};
+    }
+};
+
+// Value of `node`, with d node / d state[i] stored in gradient[i].
+template<Node T>
+double evaluate_gradient(const T &node, state_t &state, std::vector<double> &gradient) {
+    gradient_tape_t tape;
+    return tape.run(node, state, gradient);
+}
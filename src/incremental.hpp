@@ -0,0 +1,192 @@
+#pragma once
+
+#include "expr.hpp"
+#include "ast.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+/*
+ * Keeps many stored expressions evaluated while the state changes a few variables at a time. Every node caches its
+ * value; set() marks the nodes that read the changed variable, and their ancestors, dirty, and value() recomputes
+ * only dirty nodes. A dirty node always has dirty ancestors, so marking stops at the first node that already was.
+ *
+ * Expressions must not assign: re-running an assignment would apply it again, so they are rejected by add().
+ */
+struct incremental_engine_t {
+    using handle_type = std::uint32_t;
+
+    state_t m_state;
+    // number of node evaluations so far, to see how much work the cache saves
+    std::size_t m_evaluated = 0;
+
+    explicit incremental_engine_t(state_t state) : m_state(std::move(state)), m_readers(m_state.size()) {}
+
+    explicit incremental_engine_t(const symbol_table_t &symbol_table) : incremental_engine_t(symbol_table.m_state) {}
+
+    handle_type add(ast_t ast) {
+        const auto handle = static_cast<handle_type>(m_expressions.size());
+        auto &expression = m_expressions.emplace_back();
+        const auto size = static_cast<std::uint32_t>(ast.size());
+
+        // parents in compressed rows: those of node i are m_parents[m_parent_offsets[i]..m_parent_offsets[i + 1])
+        expression.m_parent_offsets.assign(size + 1, 0);
+        const auto each_child = [&ast](const std::uint32_t index, auto &&function) {
+            const auto &node = ast[index];
+            if (node.m_kind == ast_kind_t::unary || node.m_kind == ast_kind_t::binary) {
+                function(node.m_first);
+            }
+            if (node.m_kind == ast_kind_t::binary) {
+                function(node.m_second);
+            }
+        };
+        for (std::uint32_t index = 0; index < size; ++index) {
+            const auto &node = ast[index];
+            if (node.m_kind == ast_kind_t::assign) {
+                m_expressions.pop_back();
+                throw std::invalid_argument{"incremental expressions cannot assign"};
+            }
+            if (node.m_kind == ast_kind_t::variable && node.m_first >= m_state.size()) {
+                m_expressions.pop_back();
+                throw std::out_of_range{"variable is not in the state"};
+            }
+            each_child(index, [&](const std::uint32_t child) { ++expression.m_parent_offsets[child + 1]; });
+        }
+        for (std::uint32_t index = 0; index < size; ++index) {
+            expression.m_parent_offsets[index + 1] += expression.m_parent_offsets[index];
+        }
+        expression.m_parents.resize(expression.m_parent_offsets[size]);
+        auto fill = expression.m_parent_offsets;
+        for (std::uint32_t index = 0; index < size; ++index) {
+            each_child(index, [&](const std::uint32_t child) { expression.m_parents[fill[child]++] = index; });
+            if (ast[index].m_kind == ast_kind_t::variable) {
+                m_readers[ast[index].m_first].push_back({handle, index});
+            }
+        }
+
+        expression.m_values.assign(size, 0);
+        expression.m_dirty.assign(size, true);
+        expression.m_first_dirty = 0;
+        expression.m_ast = std::move(ast);
+        return handle;
+    }
+
+    template<Node T>
+    handle_type add(const T &node) {
+        return add(to_ast(node));
+    }
+
+    // Changes a variable; expressions reading it are recomputed the next time their value is asked for.
+    void set(const variable_t &variable, const double value) {
+        auto &current = m_state[variable.m_id];
+        if (std::bit_cast<std::uint64_t>(current) == std::bit_cast<std::uint64_t>(value)) {
+            return;
+        }
+        current = value;
+        for (const auto &reader: m_readers[variable.m_id]) {
+            mark_dirty(m_expressions[reader.m_expression], reader.m_node);
+        }
+    }
+
+    [[nodiscard]] double get(const variable_t &variable) const noexcept {
+        return m_state[variable.m_id];
+    }
+
+    [[nodiscard]] bool dirty(const handle_type handle) const noexcept {
+        const auto &expression = m_expressions[handle];
+        return expression.m_dirty[expression.m_ast.m_root];
+    }
+
+    // The expression's value for the current state, recomputing only what changed since it was last asked for.
+    [[nodiscard]] double value(const handle_type handle) {
+        auto &expression = m_expressions[handle];
+        const auto &ast = expression.m_ast;
+        auto *const values = expression.m_values.data();
+        const auto size = ast.size();
+        // children precede their parents, so one forward sweep from the first dirty node brings everything up to date
+        for (auto index = expression.m_first_dirty; index < size; ++index) {
+            if (!expression.m_dirty[index]) {
+                continue;
+            }
+            const auto &node = ast[index];
+            switch (node.m_kind) {
+                case ast_kind_t::constant:
+                    values[index] = ast.constant_value(node);
+                    break;
+                case ast_kind_t::variable:
+                    values[index] = m_state[node.m_first];
+                    break;
+                case ast_kind_t::unary:
+                    values[index] = node.m_operation == operation_t::minus ? -values[node.m_first]
+                                                                           : values[node.m_first];
+                    break;
+                default:
+                    values[index] = binary(node.m_operation, values[node.m_first], values[node.m_second]);
+                    break;
+            }
+            expression.m_dirty[index] = false;
+            ++m_evaluated;
+        }
+        expression.m_first_dirty = static_cast<std::uint32_t>(size);
+        return values[ast.m_root];
+    }
+
+private:
+    struct reader_t {
+        handle_type m_expression;
+        std::uint32_t m_node;
+    };
+
+    struct expression_t {
+        ast_t m_ast;
+        std::vector<double> m_values;
+        std::vector<bool> m_dirty;
+        std::vector<std::uint32_t> m_parent_offsets;
+        std::vector<std::uint32_t> m_parents;
+        // nothing before this node is dirty
+        std::uint32_t m_first_dirty = 0;
+    };
+
+    std::vector<expression_t> m_expressions;
+    // (expression, node) of every read of each variable
+    std::vector<std::vector<reader_t>> m_readers;
+    std::vector<std::uint32_t> m_pending;
+
+    void mark_dirty(expression_t &expression, const std::uint32_t node) {
+        m_pending.push_back(node);
+        while (!m_pending.empty()) {
+            const auto index = m_pending.back();
+            m_pending.pop_back();
+            if (expression.m_dirty[index]) {
+                continue;
+            }
+            expression.m_dirty[index] = true;
+            expression.m_first_dirty = std::min(expression.m_first_dirty, index);
+            for (auto parent = expression.m_parent_offsets[index];
+                 parent < expression.m_parent_offsets[index + 1]; ++parent) {
+                m_pending.push_back(expression.m_parents[parent]);
+            }
+        }
+    }
+
+    [[nodiscard]] static double binary(const operation_t operation, const double first, const double second) {
+        switch (operation) {
+            case operation_t::plus:
+                return first + second;
+            case operation_t::minus:
+                return first - second;
+            case operation_t::mul:
+                return first * second;
+            case operation_t::div:
+                if (second == 0) {
+                    throw std::logic_error{"division by zero"};
+                }
+                return first / second;
+            default:
+                throw std::logic_error{"not an arithmetic operation"};
+        }
+    }
+};
@@ -0,0 +1,316 @@
+#pragma once
+
+#include "expr.hpp"
+#include "bytecode.hpp"
+#include "simd.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Native code needs x86-64 with the System V calling convention and mmap; define DSL2_JIT=0 to always interpret.
+#ifndef DSL2_JIT
+#if DSL2_SIMD_X86 && (defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__))
+#define DSL2_JIT 1
+#else
+#define DSL2_JIT 0
+#endif
+#endif
+
+#if DSL2_JIT
+#include <sys/mman.h>
+#endif
+
+/*
+ * Translates a program_t into x86-64 machine code, one short SSE2 sequence per instruction, so running it costs no
+ * dispatch at all. Virtual registers 0..13 live in xmm0..xmm13 and the rest in a spill array; xmm14 is scratch and
+ * xmm15 holds the sign mask for negation. The emitted function follows the System V ABI:
+ *
+ *     int function(double *state, const double *constants, double *spill, double *result)
+ *
+ * It returns 0 with the program's value in *result, or 1 when a division by zero stops it, at the same point and
+ * with the same stores done as vm_t.
+ */
+struct jit_assembler_t {
+    using function_t = int (*)(double *, const double *, double *, double *);
+
+    static constexpr std::uint32_t xmm_registers = 14;
+    static constexpr std::uint8_t scratch = 14;
+    static constexpr std::uint8_t sign_mask = 15;
+
+    std::vector<std::uint8_t> m_code;
+
+    explicit jit_assembler_t(const program_t &program) {
+        // mov rax, 0x8000000000000000; movq xmm15, rax
+        emit({0x48, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0x80});
+        emit({0x66, 0x4c, 0x0f, 0x6e, 0xf8});
+
+        std::vector<std::size_t> error_jumps;
+        for (const auto &instruction: program.m_code) {
+            const auto target = instruction.m_target;
+            switch (instruction.m_opcode) {
+                case opcode_t::load_variable:
+                    load(target, memory(state, instruction.m_first));
+                    break;
+                case opcode_t::load_constant:
+                    load(target, memory(constants, instruction.m_first));
+                    break;
+                case opcode_t::negate:
+                    move(scratch, location(instruction.m_first));
+                    sse(0x66, 0x57, scratch, xmm(sign_mask)); // xorpd
+                    store(target, scratch);
+                    break;
+                case opcode_t::add:
+                case opcode_t::sub:
+                case opcode_t::mul:
+                case opcode_t::div: {
+                    const auto second = location(instruction.m_second);
+                    if (instruction.m_opcode == opcode_t::div) {
+                        // 0 == divisor, ordered: jump to the error exit
+                        sse(0x66, 0x57, scratch, xmm(scratch)); // xorpd
+                        sse(0x66, 0x2e, scratch, second); // ucomisd
+                        emit({0x7a, 0x06}); // jp +6
+                        emit({0x0f, 0x84, 0, 0, 0, 0}); // je error
+                        error_jumps.push_back(m_code.size());
+                    }
+                    auto accumulator = scratch;
+                    if (target < xmm_registers && target == instruction.m_first) {
+                        accumulator = static_cast<std::uint8_t>(target);
+                    } else {
+                        move(scratch, location(instruction.m_first));
+                    }
+                    sse(0xf2, arithmetic(instruction.m_opcode), accumulator, second);
+                    store(target, accumulator);
+                    break;
+                }
+                case opcode_t::store_assign:
+                    move(scratch, location(instruction.m_second));
+                    sse(0xf2, 0x11, scratch, memory(state, instruction.m_first)); // movsd
+                    store(target, scratch);
+                    break;
+                case opcode_t::store_add:
+                case opcode_t::store_sub:
+                case opcode_t::store_mul:
+                case opcode_t::store_div: {
+                    const auto variable = memory(state, instruction.m_first);
+                    move(scratch, variable);
+                    const auto operation = static_cast<opcode_t>(
+                            static_cast<std::uint8_t>(opcode_t::add) + static_cast<std::uint8_t>(instruction.m_opcode) -
+                            static_cast<std::uint8_t>(opcode_t::store_add));
+                    sse(0xf2, arithmetic(operation), scratch, location(instruction.m_second));
+                    sse(0xf2, 0x11, scratch, variable); // movsd
+                    store(target, scratch);
+                    break;
+                }
+                case opcode_t::ret:
+                    move(scratch, location(target));
+                    sse(0xf2, 0x11, scratch, memory(result, 0)); // movsd
+                    emit({0x31, 0xc0, 0xc3}); // xor eax, eax; ret
+                    break;
+            }
+        }
+
+        const auto error = m_code.size();
+        emit({0xb8, 1, 0, 0, 0, 0xc3}); // mov eax, 1; ret
+        for (const auto end: error_jumps) {
+            const auto offset = static_cast<std::int32_t>(error - end);
+            std::memcpy(m_code.data() + end - sizeof(offset), &offset, sizeof(offset));
+        }
+    }
+
+private:
+    // general-purpose registers holding the arguments
+    static constexpr std::uint8_t state = 7; // rdi
+    static constexpr std::uint8_t constants = 6; // rsi
+    static constexpr std::uint8_t spill = 2; // rdx
+    static constexpr std::uint8_t result = 1; // rcx
+
+    // An SSE register or a [base + displacement] memory operand.
+    struct operand_t {
+        bool m_memory;
+        std::uint8_t m_register;
+        std::int32_t m_displacement;
+    };
+
+    [[nodiscard]] static operand_t xmm(const std::uint8_t index) noexcept {
+        return {false, index, 0};
+    }
+
+    [[nodiscard]] static operand_t memory(const std::uint8_t base, const std::uint32_t index) {
+        if (index > std::numeric_limits<std::int32_t>::max() / sizeof(double)) {
+            throw std::length_error{"operand out of displacement range"};
+        }
+        return {true, base, static_cast<std::int32_t>(index * sizeof(double))};
+    }
+
+    [[nodiscard]] static operand_t location(const std::uint32_t virtual_register) {
+        if (virtual_register < xmm_registers) {
+            return xmm(static_cast<std::uint8_t>(virtual_register));
+        }
+        return memory(spill, virtual_register);
+    }
+
+    [[nodiscard]] static std::uint8_t arithmetic(const opcode_t opcode) noexcept {
+        switch (opcode) {
+            case opcode_t::add:
+                return 0x58;
+            case opcode_t::sub:
+                return 0x5c;
+            case opcode_t::mul:
+                return 0x59;
+            default:
+                return 0x5e;
+        }
+    }
+
+    void emit(const std::initializer_list<std::uint8_t> bytes) {
+        m_code.insert(m_code.end(), bytes);
+    }
+
+    // prefix [REX] 0F opcode ModRM [disp32], with `reg` in the ModRM reg field and `rm` as the other operand
+    void sse(const std::uint8_t prefix, const std::uint8_t opcode, const std::uint8_t reg, const operand_t &rm) {
+        m_code.push_back(prefix);
+        const std::uint8_t rex = 0x40 | (reg >= 8 ? 0x04 : 0) | (rm.m_register >= 8 ? 0x01 : 0);
+        if (rex != 0x40) {
+            m_code.push_back(rex);
+        }
+        m_code.push_back(0x0f);
+        m_code.push_back(opcode);
+        if (rm.m_memory) {
+            // mod 10: [base + disp32]; none of the base registers needs a SIB byte
+            m_code.push_back(static_cast<std::uint8_t>(0x80 | (reg & 7) << 3 | (rm.m_register & 7)));
+            const auto displacement = rm.m_displacement;
+            const auto *const bytes = reinterpret_cast<const std::uint8_t *>(&displacement);
+            m_code.insert(m_code.end(), bytes, bytes + sizeof(displacement));
+        } else {
+            m_code.push_back(static_cast<std::uint8_t>(0xc0 | (reg & 7) << 3 | (rm.m_register & 7)));
+        }
+    }
+
+    // xmm `to` = `from`
+    void move(const std::uint8_t to, const operand_t &from) {
+        if (from.m_memory) {
+            sse(0xf2, 0x10, to, from); // movsd
+        } else if (from.m_register != to) {
+            sse(0x66, 0x28, to, from); // movapd
+        }
+    }
+
+    // virtual register = `from`
+    void load(const std::uint32_t virtual_register, const operand_t &from) {
+        if (virtual_register < xmm_registers) {
+            move(static_cast<std::uint8_t>(virtual_register), from);
+        } else {
+            move(scratch, from);
+            store(virtual_register, scratch);
+        }
+    }
+
+    // virtual register = xmm `from`
+    void store(const std::uint32_t virtual_register, const std::uint8_t from) {
+        if (virtual_register < xmm_registers) {
+            move(static_cast<std::uint8_t>(virtual_register), xmm(from));
+        } else {
+            sse(0xf2, 0x11, from, memory(spill, virtual_register)); // movsd
+        }
+    }
+};
+
+/*
+ * A program compiled to native code when the platform allows it (DSL2_JIT, an x86-64 CPU with SSE2, and a kernel
+ * that grants executable memory), and run by vm_t otherwise; native() says which. Results, stores and division by
+ * zero errors are the same either way.
+ */
+struct jit_program_t {
+    explicit jit_program_t(program_t program) : m_program(std::move(program)), m_spill(m_program.m_registers) {
+#if DSL2_JIT
+        if (!simd_supported(simd_isa_t::sse2)) {
+            return;
+        }
+        std::vector<std::uint8_t> code;
+        try {
+            code = jit_assembler_t{m_program}.m_code;
+        } catch (const std::length_error &) {
+            // a spill slot or variable beyond what a 32-bit displacement reaches
+            return;
+        }
+        const auto size = code.size();
+        auto *const memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            return;
+        }
+        std::memcpy(memory, code.data(), size);
+        // never writable and executable at the same time
+        if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+            munmap(memory, size);
+            return;
+        }
+        m_code = memory;
+        m_code_size = size;
+        m_function = reinterpret_cast<jit_assembler_t::function_t>(memory);
+#endif
+    }
+
+    template<Node T>
+    explicit jit_program_t(const T &node) : jit_program_t(compile(node)) {}
+
+    jit_program_t(const jit_program_t &) = delete;
+    jit_program_t &operator=(const jit_program_t &) = delete;
+
+    jit_program_t(jit_program_t &&other) noexcept
+            : m_program(std::move(other.m_program)), m_spill(std::move(other.m_spill)), m_vm(std::move(other.m_vm)),
+              m_code(std::exchange(other.m_code, nullptr)), m_code_size(std::exchange(other.m_code_size, 0)),
+              m_function(std::exchange(other.m_function, nullptr)) {}
+
+    jit_program_t &operator=(jit_program_t &&other) noexcept {
+        std::swap(m_program, other.m_program);
+        std::swap(m_spill, other.m_spill);
+        std::swap(m_vm, other.m_vm);
+        std::swap(m_code, other.m_code);
+        std::swap(m_code_size, other.m_code_size);
+        std::swap(m_function, other.m_function);
+        return *this;
+    }
+
+    ~jit_program_t() {
+#if DSL2_JIT
+        if (m_code != nullptr) {
+            munmap(m_code, m_code_size);
+        }
+#endif
+    }
+
+    [[nodiscard]] bool native() const noexcept {
+        return m_function != nullptr;
+    }
+
+    [[nodiscard]] const program_t &program() const noexcept {
+        return m_program;
+    }
+
+    double run(state_t &state) {
+        if (m_function == nullptr) {
+            return m_vm.run(m_program, state);
+        }
+        if (state.size() < m_program.m_variables) {
+            throw std::out_of_range{"state is smaller than the program's variables"};
+        }
+        double result;
+        if (m_function(state.data(), m_program.m_constants.data(), m_spill.data(), &result) != 0) {
+            throw std::logic_error{"division by zero"};
+        }
+        return result;
+    }
+
+private:
+    program_t m_program;
+    std::vector<double> m_spill;
+    vm_t m_vm;
+    void *m_code = nullptr;
+    std::size_t m_code_size = 0;
+    jit_assembler_t::function_t m_function = nullptr;
+};
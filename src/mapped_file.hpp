@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define DSL2_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define DSL2_MMAP 0
+#endif
+
+/*
+ * A whole file mapped read-only into memory. Pages are read in on first access and belong to the page cache, so
+ * mapping a file larger than memory is fine; release() tells the kernel a range will not be read again, which keeps
+ * the resident set of a front-to-back scan bounded. Without mmap the file is read into a buffer instead.
+ */
+struct mapped_file_t {
+    explicit mapped_file_t(const std::filesystem::path &path) {
+#if DSL2_MMAP
+        const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error{"cannot open " + path.string()};
+        }
+        struct stat status{};
+        if (::fstat(fd, &status) != 0) {
+            ::close(fd);
+            throw std::runtime_error{"cannot stat " + path.string()};
+        }
+        m_size = static_cast<std::size_t>(status.st_size);
+        if (m_size != 0) {
+            auto *const data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error{"cannot map " + path.string()};
+            }
+            m_data = static_cast<const char *>(data);
+            ::madvise(data, m_size, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+#else
+        std::ifstream in{path, std::ios::binary};
+        if (!in) {
+            throw std::runtime_error{"cannot open " + path.string()};
+        }
+        m_buffer.assign(std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{});
+        m_data = m_buffer.data();
+        m_size = m_buffer.size();
+#endif
+    }
+
+    mapped_file_t(const mapped_file_t &) = delete;
+    mapped_file_t &operator=(const mapped_file_t &) = delete;
+
+    mapped_file_t(mapped_file_t &&other) noexcept
+            : m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0)),
+              m_buffer(std::move(other.m_buffer)) {}
+
+    mapped_file_t &operator=(mapped_file_t &&other) noexcept {
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+        std::swap(m_buffer, other.m_buffer);
+        return *this;
+    }
+
+    ~mapped_file_t() {
+#if DSL2_MMAP
+        if (m_data != nullptr) {
+            ::munmap(const_cast<char *>(m_data), m_size);
+        }
+#endif
+    }
+
+    [[nodiscard]] const char *data() const noexcept {
+        return m_data;
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept {
+        return m_size;
+    }
+
+    [[nodiscard]] std::string_view view() const noexcept {
+        return {m_data, m_size};
+    }
+
+    // Drops the whole pages inside [offset, offset + size) from memory; reading them again maps them back in.
+    void release(const std::size_t offset, const std::size_t size) const noexcept {
+#if DSL2_MMAP
+        const auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        const auto first = (offset + page - 1) / page * page;
+        const auto last = std::min(offset + size, m_size) / page * page;
+        if (m_data != nullptr && first < last) {
+            ::madvise(const_cast<char *>(m_data) + first, last - first, MADV_DONTNEED);
+        }
+#else
+        static_cast<void>(offset);
+        static_cast<void>(size);
+#endif
+    }
+
+private:
+    const char *m_data = nullptr;
+    std::size_t m_size = 0;
+    // the file's contents when it cannot be mapped
+    std::vector<char> m_buffer;
+};
@@ -0,0 +1,182 @@
+#pragma once
+
+#include "expr.hpp"
+#include "batch.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+// Number of nodes in an expression, as an estimate of the work evaluating it takes.
+template<typename T>
+constexpr std::size_t node_count_v = 1;
+
+template<Node T>
+constexpr std::size_t node_count_v<unary_t<T>> = 1 + node_count_v<T>;
+
+template<Node First, Node Second>
+constexpr std::size_t node_count_v<binary_t<First, Second>> = 1 + node_count_v<First> + node_count_v<Second>;
+
+template<Node Second>
+constexpr std::size_t node_count_v<assign_t<Second>> = 2 + node_count_v<Second>;
+
+// Evaluates the two operands of a binary_t on different threads when both are large enough to be worth it and
+// neither writes the state; everything else is evaluated inline by eval_visitor_t, so results are identical.
+struct parallel_eval_visitor_t {
+    state_t &m_state;
+    thread_pool_t &m_pool;
+    // operands with fewer nodes than this are not split off
+    std::size_t m_min_nodes;
+
+    parallel_eval_visitor_t(state_t &state, thread_pool_t &pool, const std::size_t min_nodes)
+            : m_state(state), m_pool(pool), m_min_nodes(min_nodes) {}
+
+    template<Node T>
+    [[nodiscard]] double visit(const unary_t<T> &node) const {
+        if (node_count_v<T> < m_min_nodes) {
+            return eval_visitor_t{m_state}.visit(node);
+        }
+        const auto value = visit(node.m_value);
+        return node.m_operation == operation_t::minus ? -value : value;
+    }
+
+    template<Node First, Node Second>
+    [[nodiscard]] double visit(const binary_t<First, Second> &node) const {
+        if constexpr (writes_state_v<First> || writes_state_v<Second>) {
+            return eval_visitor_t{m_state}.visit(node);
+        } else {
+            if (node_count_v<First> < m_min_nodes || node_count_v<Second> < m_min_nodes) {
+                if (node_count_v<First> < m_min_nodes && node_count_v<Second> < m_min_nodes) {
+                    return eval_visitor_t{m_state}.visit(node);
+                }
+                // one side is large: it may still contain a split further down
+                return apply(node.m_operation, visit(node.m_first), visit(node.m_second));
+            }
+            double first = 0;
+            double second = 0;
+            m_pool.parallel_for(2, [&](const std::size_t operand) {
+                if (operand == 0) {
+                    first = visit(node.m_first);
+                } else {
+                    second = visit(node.m_second);
+                }
+            });
+            return apply(node.m_operation, first, second);
+        }
+    }
+
+    template<Node T>
+    [[nodiscard]] double visit(const T &node) const {
+        return eval_visitor_t{m_state}.visit(node);
+    }
+
+private:
+    [[nodiscard]] static double apply(const operation_t operation, const double first, const double second) {
+        switch (operation) {
+            case operation_t::plus:
+                return first + second;
+            case operation_t::minus:
+                return first - second;
+            case operation_t::mul:
+                return first * second;
+            case operation_t::div:
+                if (second == 0) {
+                    throw std::logic_error{"division by zero"};
+                }
+                return first / second;
+            default:
+                throw std::logic_error{"not an arithmetic operation"};
+        }
+    }
+};
+
+template<Node T>
+[[nodiscard]] double parallel_eval(const T &node, state_t &state, thread_pool_t &pool,
+                                   const std::size_t min_nodes = 4096) {
+    const parallel_eval_visitor_t visitor{state, pool, min_nodes};
+    return visitor.visit(node.get());
+}
+
+// Rows per chunk of parallel batch work: a whole number of blocks, sized so that the chunk's slice of every column
+// plus its output fits in `cache_bytes` (about one core's L2).
+[[nodiscard]] inline std::size_t batch_chunk_rows(const std::size_t columns,
+                                                 const std::size_t cache_bytes = 256 * 1024) {
+    constexpr auto block_size = batch_eval_visitor_t<>::block_size;
+    const auto rows = cache_bytes / (sizeof(double) * (columns + 1));
+    return std::max(block_size, rows / block_size * block_size);
+}
+
+/*
+ * A batch with every row set to the symbol table's initial values, filled chunk by chunk on the pool. The columns
+ * are allocated untouched, so each page is first written, and with first-touch NUMA placement allocated, on a
+ * thread that works on those rows. Stealing moves some chunks between threads from run to run, so placement is
+ * only mostly local; it never affects results.
+ */
+[[nodiscard]] inline batch_t make_batch(const symbol_table_t &symbol_table, const std::size_t rows,
+                                        thread_pool_t &pool, std::size_t chunk_rows = 0) {
+    batch_t batch{symbol_table.m_state.size(), rows, batch_t::uninitialised};
+    if (chunk_rows == 0) {
+        chunk_rows = batch_chunk_rows(batch.m_columns);
+    }
+    const auto chunks = (rows + chunk_rows - 1) / chunk_rows;
+    pool.parallel_for(chunks, [&](const std::size_t chunk) {
+        const auto first = chunk * chunk_rows;
+        const auto count = std::min(chunk_rows, rows - first);
+        for (std::size_t id = 0; id < batch.m_columns; ++id) {
+            std::ranges::fill(batch.column(id).subspan(first, count), symbol_table.m_state[id]);
+        }
+    });
+    return batch;
+}
+
+/*
+ * batch_eval() spread over the pool: the rows are cut into chunks of `chunk_rows` (batch_chunk_rows() when 0) and
+ * every chunk is evaluated with the SIMD kernels by whichever thread takes it. Results are identical to batch_eval().
+ * The policy is shared by all threads; sticky_error_t gets one flag per chunk, merged once every chunk is done.
+ */
+template<Node T, ErrorPolicy Policy = throw_on_error_t>
+void parallel_batch_eval(const T &node, batch_t &batch, const std::span<double> out, thread_pool_t &pool,
+                         std::size_t chunk_rows = 0, const simd_kernels_t &kernels = simd_kernels(),
+                         const Policy &policy = {}) {
+    if (out.size() < batch.rows()) {
+        throw std::length_error{"output column is shorter than the batch"};
+    }
+    if (chunk_rows == 0) {
+        chunk_rows = batch_chunk_rows(batch.m_columns);
+    }
+    const auto rows = batch.rows();
+    const auto chunks = (rows + chunk_rows - 1) / chunk_rows;
+    const auto range = [&](const std::size_t chunk) {
+        return std::pair{chunk * chunk_rows, std::min(rows, (chunk + 1) * chunk_rows)};
+    };
+
+    if constexpr (std::same_as<Policy, sticky_error_t>) {
+        // bool rather than vector<bool>, so neighbouring chunks do not share a word
+        const auto errors = std::make_unique<bool[]>(chunks);
+        pool.parallel_for(chunks, [&](const std::size_t chunk) {
+            const auto [first, last] = range(chunk);
+            batch_eval_rows(node, batch, out, first, last, kernels, sticky_error_t{errors[chunk]});
+        });
+        policy.check(std::any_of(errors.get(), errors.get() + chunks, [](const bool error) { return error; }));
+    } else {
+        pool.parallel_for(chunks, [&](const std::size_t chunk) {
+            const auto [first, last] = range(chunk);
+            batch_eval_rows(node, batch, out, first, last, kernels, policy);
+        });
+    }
+}
+
+template<Node T, ErrorPolicy Policy = throw_on_error_t>
+[[nodiscard]] std::vector<double> parallel_batch_eval(const T &node, batch_t &batch, thread_pool_t &pool,
+                                                      const std::size_t chunk_rows = 0,
+                                                      const simd_kernels_t &kernels = simd_kernels(),
+                                                      const Policy &policy = {}) {
+    std::vector<double> out(batch.rows());
+    parallel_batch_eval(node, batch, out, pool, chunk_rows, kernels, policy);
+    return out;
+}
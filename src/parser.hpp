@@ -0,0 +1,306 @@
+#pragma once
+
+#include "expr.hpp"
+#include "bytecode.hpp"
+
+#include <charconv>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct parse_error : std::runtime_error {
+    std::size_t m_position;
+
+    parse_error(const std::string &message, const std::size_t position) : std::runtime_error(
+            message + " at offset " + std::to_string(position)), m_position(position) {}
+};
+
+/*
+ * Recursive-descent parser for the syntax print_visitor emits:
+ *
+ *   statements := statement ((';' | '\n') statement)*
+ *   statement  := name ('<<=' | '+=' | '-=' | '*=' | '/=') statement | sum
+ *   sum        := product (('+' | '-') product)*
+ *   product    := unary (('*' | '/') unary)*
+ *   unary      := ('+' | '-') unary | number | name | '(' statement ')'
+ *
+ * Nodes are handed to a Builder in post-order, mirroring how the operator overloads in expr.hpp
+ * build binary_t and friends:
+ *
+ *   handle constant(double), variable(std::size_t id), unary(operation_t, handle),
+ *   binary(operation_t, handle, handle), assign(operation_t, std::size_t id, handle)
+ */
+template<typename Builder>
+struct parser_t {
+    using handle_type = decltype(std::declval<Builder &>().constant(0.0));
+
+    static constexpr std::size_t max_depth = 256;
+
+    std::string_view m_text;
+    const symbol_table_t &m_symbol_table;
+    Builder &m_builder;
+    std::size_t m_position = 0;
+    std::size_t m_depth = 0;
+
+    parser_t(const std::string_view text, const symbol_table_t &symbol_table, Builder &builder)
+            : m_text(text), m_symbol_table(symbol_table), m_builder(builder) {}
+
+    // Skips blank lines and separators; true when another statement follows.
+    [[nodiscard]] bool next_statement() noexcept {
+        while (m_position < m_text.size()) {
+            const auto c = m_text[m_position];
+            if (c != ';' && c != '\n' && !is_blank(c)) {
+                return true;
+            }
+            ++m_position;
+        }
+        return false;
+    }
+
+    // Parses one statement and requires it to end at a separator or the end of the text.
+    handle_type parse_statement() {
+        auto result = statement();
+        skip_blanks();
+        if (m_position < m_text.size() && m_text[m_position] != ';' && m_text[m_position] != '\n') {
+            fail("unexpected character");
+        }
+        return result;
+    }
+
+private:
+    [[nodiscard]] static constexpr bool is_blank(const char c) noexcept {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    [[nodiscard]] static constexpr bool is_name_start(const char c) noexcept {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+
+    [[nodiscard]] static constexpr bool is_digit(const char c) noexcept {
+        return c >= '0' && c <= '9';
+    }
+
+    [[noreturn]] void fail(const std::string &message) const {
+        throw parse_error{message, m_position};
+    }
+
+    void skip_blanks() noexcept {
+        while (m_position < m_text.size() && is_blank(m_text[m_position])) {
+            ++m_position;
+        }
+    }
+
+    [[nodiscard]] char peek() noexcept {
+        skip_blanks();
+        return m_position < m_text.size() ? m_text[m_position] : '\0';
+    }
+
+    [[nodiscard]] std::string_view name() noexcept {
+        const auto start = m_position;
+        while (m_position < m_text.size() && (is_name_start(m_text[m_position]) || is_digit(m_text[m_position]))) {
+            ++m_position;
+        }
+        return m_text.substr(start, m_position - start);
+    }
+
+    // `start` is the name's offset, reported when it is unknown
+    [[nodiscard]] std::size_t lookup(const std::string_view name, const std::size_t start) const {
+        const auto id = m_symbol_table.find(name);
+        if (id == symbol_table_t::npos) {
+            throw parse_error{"unknown variable '" + std::string{name} + "'", start};
+        }
+        return id;
+    }
+
+    // Matches an assignment operator without consuming it unless it is one.
+    [[nodiscard]] bool assignment(operation_t &operation) noexcept {
+        skip_blanks();
+        const auto rest = m_text.substr(m_position);
+        constexpr std::pair<std::string_view, operation_t> operators[] = {
+                {"<<=", operation_t::assign},
+                {"+=",  operation_t::plus},
+                {"-=",  operation_t::minus},
+                {"*=",  operation_t::mul},
+                {"/=",  operation_t::div},
+        };
+        for (const auto &[token, op]: operators) {
+            if (rest.starts_with(token)) {
+                m_position += token.size();
+                operation = op;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    struct depth_guard_t {
+        parser_t &m_parser;
+
+        explicit depth_guard_t(parser_t &parser) : m_parser(parser) {
+            if (++m_parser.m_depth > max_depth) {
+                m_parser.fail("expression nested too deeply");
+            }
+        }
+
+        ~depth_guard_t() {
+            --m_parser.m_depth;
+        }
+    };
+
+    handle_type statement() {
+        const depth_guard_t guard{*this};
+        if (is_name_start(peek())) {
+            const auto start = m_position;
+            const auto target = name();
+            operation_t operation;
+            if (assignment(operation)) {
+                const auto id = lookup(target, start);
+                auto value = statement();
+                return m_builder.assign(operation, id, value);
+            }
+            m_position = start;
+        }
+        return sum();
+    }
+
+    handle_type sum() {
+        auto result = product();
+        for (;;) {
+            const auto c = peek();
+            operation_t operation;
+            if (c == '+') {
+                operation = operation_t::plus;
+            } else if (c == '-') {
+                operation = operation_t::minus;
+            } else {
+                return result;
+            }
+            // `a-b+=c` is not valid: assignments need a bare variable on the left
+            if (m_position + 1 < m_text.size() && m_text[m_position + 1] == '=') {
+                fail("assignment to an expression");
+            }
+            ++m_position;
+            auto second = product();
+            result = m_builder.binary(operation, result, second);
+        }
+    }
+
+    handle_type product() {
+        auto result = unary();
+        for (;;) {
+            const auto c = peek();
+            operation_t operation;
+            if (c == '*') {
+                operation = operation_t::mul;
+            } else if (c == '/') {
+                operation = operation_t::div;
+            } else {
+                return result;
+            }
+            if (m_position + 1 < m_text.size() && m_text[m_position + 1] == '=') {
+                fail("assignment to an expression");
+            }
+            ++m_position;
+            auto second = unary();
+            result = m_builder.binary(operation, result, second);
+        }
+    }
+
+    handle_type unary() {
+        const depth_guard_t guard{*this};
+        const auto c = peek();
+        switch (c) {
+            case '+':
+                ++m_position;
+                return m_builder.unary(operation_t::plus, unary());
+            case '-':
+                ++m_position;
+                return m_builder.unary(operation_t::minus, unary());
+            case '(': {
+                ++m_position;
+                auto result = statement();
+                if (peek() != ')') {
+                    fail("expected ')'");
+                }
+                ++m_position;
+                return result;
+            }
+            default:
+                break;
+        }
+        if (is_digit(c) || c == '.') {
+            double value;
+            const auto begin = m_text.data() + m_position;
+            const auto [end, error] = std::from_chars(begin, m_text.data() + m_text.size(), value);
+            if (error != std::errc{}) {
+                fail("malformed number");
+            }
+            m_position += static_cast<std::size_t>(end - begin);
+            return m_builder.constant(value);
+        }
+        if (is_name_start(c)) {
+            const auto start = m_position;
+            const auto variable = name();
+            return m_builder.variable(lookup(variable, start));
+        }
+        fail(m_position < m_text.size() ? "unexpected character" : "unexpected end of input");
+    }
+};
+
+// Adapts program_builder_t to the parser: handles are registers, allocated as a stack in parse order.
+struct bytecode_sink_t {
+    program_builder_t m_builder;
+    std::uint32_t m_top = 0;
+
+    std::uint32_t constant(const double value) {
+        return m_builder.constant(m_top++, value);
+    }
+
+    std::uint32_t variable(const std::size_t id) {
+        return m_builder.variable(m_top++, id);
+    }
+
+    std::uint32_t unary(const operation_t operation, const std::uint32_t value) {
+        return m_builder.unary(operation, value);
+    }
+
+    std::uint32_t binary(const operation_t operation, const std::uint32_t first, const std::uint32_t second) {
+        --m_top;
+        return m_builder.binary(operation, first, second);
+    }
+
+    std::uint32_t assign(const operation_t operation, const std::size_t id, const std::uint32_t value) {
+        return m_builder.assign(operation, id, value);
+    }
+};
+
+// Parses a single statement into bytecode.
+[[nodiscard]] inline program_t parse_program(const std::string_view text, const symbol_table_t &symbol_table) {
+    bytecode_sink_t sink;
+    parser_t parser{text, symbol_table, sink};
+    if (!parser.next_statement()) {
+        throw parse_error{"empty expression", 0};
+    }
+    const auto result = parser.parse_statement();
+    if (parser.next_statement()) {
+        throw parse_error{"more than one statement", parser.m_position};
+    }
+    return sink.m_builder.finish(result);
+}
+
+// Parses every statement of a formula file into its own program.
+[[nodiscard]] inline std::vector<program_t> parse_programs(const std::string_view text,
+                                                           const symbol_table_t &symbol_table) {
+    std::vector<program_t> programs;
+    bytecode_sink_t sink;
+    parser_t parser{text, symbol_table, sink};
+    while (parser.next_statement()) {
+        sink = {};
+        const auto result = parser.parse_statement();
+        programs.push_back(sink.m_builder.finish(result));
+    }
+    return programs;
+}
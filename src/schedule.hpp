@@ -0,0 +1,187 @@
+#pragma once
+
+#include "expr.hpp"
+#include "ast.hpp"
+#include "bytecode.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+/*
+ * A list of statements (usually assignments) compiled into one program. The order they were given in defines the
+ * result; the read/write dependency graph over variable ids decides how they may be regrouped. Statements are
+ * placed in waves: a statement's wave is one past the latest wave of any earlier statement that writes a variable
+ * it reads or writes, or reads a variable it writes. Statements within one wave are independent of each other.
+ */
+struct schedule_t {
+    std::vector<ast_t> m_statements;
+    // for each statement, the earlier statements it has to run after
+    std::vector<std::vector<std::uint32_t>> m_dependencies;
+    // statement indices by wave
+    std::vector<std::vector<std::uint32_t>> m_waves;
+    // every statement, wave by wave, returning the value of the statement given last
+    program_t m_program;
+    // each statement on its own, for running the statements of a wave on different threads
+    std::vector<program_t> m_programs;
+    // number of nodes in each wave, as an estimate of its work
+    std::vector<std::size_t> m_wave_nodes;
+    // waves with less work than this run inline: handing them to the pool would cost more than it saves
+    std::size_t m_min_parallel_nodes = 4096;
+
+    // Runs the whole list of statements and returns the value of the last one.
+    double run(state_t &state) {
+        return m_vm.run(m_program, state);
+    }
+
+    // The same, with the statements of each wave spread over `pool`. Statements in one wave neither write a variable
+    // another one reads or writes, so they run concurrently without synchronisation; each wave is a barrier.
+    double run(state_t &state, thread_pool_t &pool) {
+        if (pool.size() == 0 || std::ranges::none_of(m_wave_nodes, [this](const std::size_t nodes) {
+            return nodes >= m_min_parallel_nodes;
+        })) {
+            return run(state);
+        }
+
+        const auto last = m_statements.size() - 1;
+        double result = 0;
+        for (std::size_t wave = 0; wave < m_waves.size(); ++wave) {
+            const auto &statements = m_waves[wave];
+            const auto execute = [&](const std::size_t i) {
+                // each thread keeps its own registers
+                thread_local vm_t vm;
+                const auto value = vm.run(m_programs[statements[i]], state);
+                if (statements[i] == last) {
+                    result = value;
+                }
+            };
+            if (statements.size() > 1 && m_wave_nodes[wave] >= m_min_parallel_nodes) {
+                pool.parallel_for(statements.size(), execute);
+            } else {
+                for (std::size_t i = 0; i < statements.size(); ++i) {
+                    execute(i);
+                }
+            }
+        }
+        return result;
+    }
+
+private:
+    vm_t m_vm;
+};
+
+struct statement_access_t {
+    std::vector<std::uint32_t> m_reads;
+    std::vector<std::uint32_t> m_writes;
+};
+
+// The variable ids a statement reads and writes; a compound assignment both reads and writes its variable.
+[[nodiscard]] inline statement_access_t statement_access(const ast_t &ast) {
+    statement_access_t access;
+    for (const auto &node: ast.m_nodes) {
+        if (node.m_kind == ast_kind_t::variable) {
+            access.m_reads.push_back(node.m_first);
+        } else if (node.m_kind == ast_kind_t::assign) {
+            access.m_writes.push_back(node.m_first);
+            if (node.m_operation != operation_t::assign) {
+                access.m_reads.push_back(node.m_first);
+            }
+        }
+    }
+    for (auto *ids: {&access.m_reads, &access.m_writes}) {
+        std::ranges::sort(*ids);
+        const auto [first, last] = std::ranges::unique(*ids);
+        ids->erase(first, last);
+    }
+    return access;
+}
+
+[[nodiscard]] inline schedule_t schedule(std::vector<ast_t> statements) {
+    if (statements.empty()) {
+        throw std::invalid_argument{"empty program"};
+    }
+
+    schedule_t schedule;
+    const auto count = static_cast<std::uint32_t>(statements.size());
+    constexpr auto none = ~std::uint32_t{0};
+    // per variable: the last statement writing it and the statements reading it since
+    std::vector<std::uint32_t> last_writer;
+    std::vector<std::vector<std::uint32_t>> readers;
+    std::vector<std::uint32_t> wave(count, 0);
+    schedule.m_dependencies.resize(count);
+
+    for (std::uint32_t statement = 0; statement < count; ++statement) {
+        const auto access = statement_access(statements[statement]);
+        const auto variables = std::max(access.m_reads.empty() ? 0 : access.m_reads.back() + 1,
+                                        access.m_writes.empty() ? 0 : access.m_writes.back() + 1);
+        if (variables > last_writer.size()) {
+            last_writer.resize(variables, none);
+            readers.resize(variables);
+        }
+
+        auto &dependencies = schedule.m_dependencies[statement];
+        for (const auto id: access.m_reads) {
+            if (last_writer[id] != none) {
+                dependencies.push_back(last_writer[id]);
+            }
+        }
+        for (const auto id: access.m_writes) {
+            if (last_writer[id] != none) {
+                dependencies.push_back(last_writer[id]);
+            }
+            dependencies.insert(dependencies.end(), readers[id].begin(), readers[id].end());
+        }
+        std::ranges::sort(dependencies);
+        const auto [first, last] = std::ranges::unique(dependencies);
+        dependencies.erase(first, last);
+
+        for (const auto id: access.m_writes) {
+            last_writer[id] = statement;
+            readers[id].clear();
+        }
+        for (const auto id: access.m_reads) {
+            if (last_writer[id] != statement) {
+                readers[id].push_back(statement);
+            }
+        }
+
+        for (const auto dependency: dependencies) {
+            wave[statement] = std::max(wave[statement], wave[dependency] + 1);
+        }
+        if (wave[statement] >= schedule.m_waves.size()) {
+            schedule.m_waves.resize(wave[statement] + 1);
+        }
+        schedule.m_waves[wave[statement]].push_back(statement);
+    }
+
+    // Nothing in a later wave conflicts with the last statement (it would have been placed after it otherwise), so
+    // the last statement can go at the very end and its register is what the program returns.
+    program_builder_t builder;
+    const auto last = count - 1;
+    for (const auto &statements_in_wave: schedule.m_waves) {
+        auto &nodes = schedule.m_wave_nodes.emplace_back(0);
+        for (const auto statement: statements_in_wave) {
+            nodes += statements[statement].size();
+            if (statement != last) {
+                (void) compile(builder, statements[statement]);
+            }
+        }
+    }
+    for (const auto &statement: statements) {
+        schedule.m_programs.push_back(compile(statement));
+    }
+    const auto result = compile(builder, statements[last]);
+    schedule.m_program = builder.finish(result);
+    schedule.m_statements = std::move(statements);
+    return schedule;
+}
+
+template<Node... T>
+[[nodiscard]] schedule_t schedule(const T &... statements) {
+    std::vector<ast_t> asts;
+    asts.reserve(sizeof...(T));
+    (asts.push_back(to_ast(statements)), ...);
+    return schedule(std::move(asts));
+}
@@ -0,0 +1,261 @@
+#pragma once
+
+#include "expr.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+// Instruction sets with a hand-written kernel set, in increasing order of preference.
+enum class simd_isa_t {
+    scalar,
+    sse2,
+    avx2,
+    avx512,
+};
+
+// Column kernels indexed by operation_t; `operation_t::assign` copies (or broadcasts) the second operand.
+struct simd_kernels_t {
+    using column_column_t = void (*)(double *out, const double *a, const double *b, std::size_t n) noexcept;
+    using column_scalar_t = void (*)(double *out, const double *a, double b, std::size_t n) noexcept;
+    using scalar_column_t = void (*)(double *out, double a, const double *b, std::size_t n) noexcept;
+    using negate_t = void (*)(double *out, const double *a, std::size_t n) noexcept;
+    using any_zero_t = bool (*)(const double *a, std::size_t n) noexcept;
+
+    simd_isa_t m_isa;
+    std::array<column_column_t, 5> m_column_column;
+    std::array<column_scalar_t, 5> m_column_scalar;
+    std::array<scalar_column_t, 5> m_scalar_column;
+    negate_t m_negate;
+    any_zero_t m_any_zero;
+};
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define DSL2_SIMD_X86 1
+#else
+#define DSL2_SIMD_X86 0
+#endif
+
+// The kernel bodies are written once against GCC/Clang vector extensions and always inlined into per-ISA
+// entry points, so each entry point is compiled for its own target and the vector width matches the registers.
+template<std::size_t Width>
+struct simd_vector {
+    typedef double type __attribute__((vector_size(Width * sizeof(double))));
+};
+
+template<operation_t Operation, typename T>
+[[gnu::always_inline]] inline void simd_combine(T &out, const T &a, const T &b) noexcept {
+    if constexpr (Operation == operation_t::assign) {
+        out = b;
+    } else if constexpr (Operation == operation_t::plus) {
+        out = a + b;
+    } else if constexpr (Operation == operation_t::minus) {
+        out = a - b;
+    } else if constexpr (Operation == operation_t::mul) {
+        out = a * b;
+    } else {
+        out = a / b;
+    }
+}
+
+template<typename T>
+[[gnu::always_inline]] inline void simd_load(T &out, const double *data) noexcept {
+    std::memcpy(&out, data, sizeof(T));
+}
+
+template<typename T>
+[[gnu::always_inline]] inline void simd_store(double *data, const T &value) noexcept {
+    std::memcpy(data, &value, sizeof(T));
+}
+
+// `A` and `B` are either `const double *` (a column) or `double` (broadcast to every lane).
+template<std::size_t Width, operation_t Operation, typename A, typename B>
+[[gnu::always_inline]] inline void simd_binary(double *out, const A a, const B b, const std::size_t n) noexcept {
+    constexpr auto is_column_a = std::is_pointer_v<A>;
+    constexpr auto is_column_b = std::is_pointer_v<B>;
+
+    std::size_t i = 0;
+    if constexpr (Width > 1) {
+        using vector_t = typename simd_vector<Width>::type;
+        vector_t va{}, vb{}, result;
+        if constexpr (!is_column_a) {
+            va += a;
+        }
+        if constexpr (!is_column_b) {
+            vb += b;
+        }
+        for (; i + Width <= n; i += Width) {
+            if constexpr (is_column_a) {
+                simd_load(va, a + i);
+            }
+            if constexpr (is_column_b) {
+                simd_load(vb, b + i);
+            }
+            simd_combine<Operation>(result, va, vb);
+            simd_store(out + i, result);
+        }
+    }
+    for (; i < n; ++i) {
+        double result;
+        double sa, sb;
+        if constexpr (is_column_a) {
+            sa = a[i];
+        } else {
+            sa = a;
+        }
+        if constexpr (is_column_b) {
+            sb = b[i];
+        } else {
+            sb = b;
+        }
+        simd_combine<Operation>(result, sa, sb);
+        out[i] = result;
+    }
+}
+
+template<std::size_t Width>
+[[gnu::always_inline]] inline void simd_negate(double *out, const double *a, const std::size_t n) noexcept {
+    std::size_t i = 0;
+    if constexpr (Width > 1) {
+        using vector_t = typename simd_vector<Width>::type;
+        vector_t va;
+        for (; i + Width <= n; i += Width) {
+            simd_load(va, a + i);
+            va = -va;
+            simd_store(out + i, va);
+        }
+    }
+    for (; i < n; ++i) {
+        out[i] = -a[i];
+    }
+}
+
+template<std::size_t Width>
+[[gnu::always_inline]] inline bool simd_any_zero(const double *a, const std::size_t n) noexcept {
+    std::size_t i = 0;
+    bool zero = false;
+    if constexpr (Width > 1) {
+        using vector_t = typename simd_vector<Width>::type;
+        using mask_t = decltype(vector_t{} == vector_t{});
+        vector_t va;
+        mask_t mask{};
+        for (; i + Width <= n; i += Width) {
+            simd_load(va, a + i);
+            mask |= va == 0;
+        }
+        for (std::size_t lane = 0; lane < Width; ++lane) {
+            zero |= mask[lane] != 0;
+        }
+    }
+    for (; i < n; ++i) {
+        zero |= a[i] == 0;
+    }
+    return zero;
+}
+
+// Declares the entry points of one kernel set; `target` is empty for the baseline instruction set.
+#define DSL2_SIMD_KERNEL_SET(name, width, target)                                                              \
+    struct simd_##name##_t {                                                                                   \
+        template<operation_t Operation>                                                                        \
+        target static void column_column(double *out, const double *a, const double *b, std::size_t n) noexcept { \
+            simd_binary<width, Operation>(out, a, b, n);                                                       \
+        }                                                                                                      \
+        template<operation_t Operation>                                                                        \
+        target static void column_scalar(double *out, const double *a, double b, std::size_t n) noexcept {    \
+            simd_binary<width, Operation>(out, a, b, n);                                                       \
+        }                                                                                                      \
+        template<operation_t Operation>                                                                        \
+        target static void scalar_column(double *out, double a, const double *b, std::size_t n) noexcept {    \
+            simd_binary<width, Operation>(out, a, b, n);                                                       \
+        }                                                                                                      \
+        target static void negate(double *out, const double *a, std::size_t n) noexcept {                     \
+            simd_negate<width>(out, a, n);                                                                     \
+        }                                                                                                      \
+        target static bool any_zero(const double *a, std::size_t n) noexcept {                                 \
+            return simd_any_zero<width>(a, n);                                                                 \
+        }                                                                                                      \
+    }
+
+DSL2_SIMD_KERNEL_SET(scalar, 1, );
+#if DSL2_SIMD_X86
+// SSE2 is part of the x86-64 baseline, so it needs no target attribute.
+DSL2_SIMD_KERNEL_SET(sse2, 2, );
+DSL2_SIMD_KERNEL_SET(avx2, 4, [[gnu::target("avx2")]]);
+DSL2_SIMD_KERNEL_SET(avx512, 8, [[gnu::target("avx512f")]]);
+#endif
+
+#undef DSL2_SIMD_KERNEL_SET
+
+template<typename Set>
+[[nodiscard]] constexpr simd_kernels_t make_simd_kernels(const simd_isa_t isa) noexcept {
+    using enum operation_t;
+    return {
+            isa,
+            {&Set::template column_column<assign>, &Set::template column_column<plus>,
+             &Set::template column_column<minus>, &Set::template column_column<mul>,
+             &Set::template column_column<div>},
+            {&Set::template column_scalar<assign>, &Set::template column_scalar<plus>,
+             &Set::template column_scalar<minus>, &Set::template column_scalar<mul>,
+             &Set::template column_scalar<div>},
+            {&Set::template scalar_column<assign>, &Set::template scalar_column<plus>,
+             &Set::template scalar_column<minus>, &Set::template scalar_column<mul>,
+             &Set::template scalar_column<div>},
+            &Set::negate,
+            &Set::any_zero,
+    };
+}
+
+[[nodiscard]] inline bool simd_supported(const simd_isa_t isa) noexcept {
+    switch (isa) {
+        case simd_isa_t::scalar:
+            return true;
+#if DSL2_SIMD_X86
+        case simd_isa_t::sse2:
+            return true;
+        case simd_isa_t::avx2:
+            return __builtin_cpu_supports("avx2");
+        case simd_isa_t::avx512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+            return false;
+    }
+}
+
+// Kernels for a specific instruction set; falls back to the scalar kernels when the CPU lacks it.
+[[nodiscard]] inline const simd_kernels_t &simd_kernels(const simd_isa_t isa) noexcept {
+    static const simd_kernels_t scalar = make_simd_kernels<simd_scalar_t>(simd_isa_t::scalar);
+#if DSL2_SIMD_X86
+    static const simd_kernels_t sse2 = make_simd_kernels<simd_sse2_t>(simd_isa_t::sse2);
+    static const simd_kernels_t avx2 = make_simd_kernels<simd_avx2_t>(simd_isa_t::avx2);
+    static const simd_kernels_t avx512 = make_simd_kernels<simd_avx512_t>(simd_isa_t::avx512);
+    if (!simd_supported(isa)) {
+        return scalar;
+    }
+    switch (isa) {
+        case simd_isa_t::sse2:
+            return sse2;
+        case simd_isa_t::avx2:
+            return avx2;
+        case simd_isa_t::avx512:
+            return avx512;
+        default:
+            break;
+    }
+#endif
+    return scalar;
+}
+
+// The widest kernel set the running CPU supports, detected once.
+[[nodiscard]] inline const simd_kernels_t &simd_kernels() noexcept {
+    static const simd_kernels_t &best = [] () -> const simd_kernels_t & {
+        for (auto isa: {simd_isa_t::avx512, simd_isa_t::avx2, simd_isa_t::sse2}) {
+            if (simd_supported(isa)) {
+                return simd_kernels(isa);
+            }
+        }
+        return simd_kernels(simd_isa_t::scalar);
+    }();
+    return best;
+}
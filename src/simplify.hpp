@@ -0,0 +1,447 @@
+#pragma once
+
+#include "expr.hpp"
+#include "ast.hpp"
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct simplify_options_t {
+    // also apply the rules that may change a result: for NaN, infinities or signed zeros, or by rounding differently
+    bool m_fast_math = false;
+};
+
+struct simplify_stats_t {
+    // nodes reachable from the root before and after the pass
+    std::size_t m_nodes_before = 0;
+    std::size_t m_nodes_after = 0;
+    std::size_t m_rewrites = 0;
+
+    [[nodiscard]] constexpr std::size_t removed() const noexcept {
+        return m_nodes_before - m_nodes_after;
+    }
+};
+
+struct simplify_pass_t;
+
+// One entry of the rule table: given a node whose operands are already simplified, returns the index of its
+// replacement in the pass's result, or simplify_pass_t::no_match.
+struct simplify_rule_t {
+    std::string_view m_name;
+    // the rewrite may change a result, so it is only applied under simplify_options_t::m_fast_math
+    bool m_fast_math;
+    ast_t::index_type (*m_apply)(simplify_pass_t &pass, ast_node_t node);
+};
+
+/*
+ * Rebuilds an ast_t bottom-up, rewriting every unary and binary node with the first matching rule of
+ * simplify_rules until none matches, then drops the nodes nothing refers to any more. Without fast math every rule
+ * is an exact IEEE identity, so the result computes the same values, writes the same variables and throws the same
+ * division by zero errors. Assignments are never removed, reordered or duplicated, and no rule drops an operand
+ * that assigns or divides.
+ *
+ * Everything is constexpr, so an expression template can be simplified at compile time.
+ */
+struct simplify_pass_t {
+    static constexpr auto no_match = ~ast_t::index_type{0};
+
+    simplify_options_t m_options;
+    simplify_stats_t m_stats;
+
+    constexpr explicit simplify_pass_t(const simplify_options_t &options = {}) : m_options(options) {}
+
+    [[nodiscard]] constexpr ast_t run(const ast_t &ast);
+
+    // Helpers for the rules; indices refer to the result being built.
+
+    [[nodiscard]] constexpr const ast_node_t &node(const ast_t::index_type index) const noexcept {
+        return m_result[index];
+    }
+
+    [[nodiscard]] constexpr bool is_constant(const ast_t::index_type index) const noexcept {
+        return m_result[index].m_kind == ast_kind_t::constant;
+    }
+
+    // compares bit patterns, so 0 and -0 differ
+    [[nodiscard]] constexpr bool is_constant(const ast_t::index_type index, const double value) const noexcept {
+        return is_constant(index) &&
+               std::bit_cast<std::uint64_t>(constant_value(index)) == std::bit_cast<std::uint64_t>(value);
+    }
+
+    [[nodiscard]] constexpr double constant_value(const ast_t::index_type index) const noexcept {
+        return m_result.constant_value(m_result[index]);
+    }
+
+    [[nodiscard]] constexpr bool is_negation(const ast_t::index_type index) const noexcept {
+        return m_result[index].m_kind == ast_kind_t::unary && m_result[index].m_operation == operation_t::minus;
+    }
+
+    // Whether evaluating a subtree can neither write a variable nor throw, so it may be dropped. Answers are kept
+    // for every node up to `index`, each worked out from its operands', so no call recurses or repeats work.
+    [[nodiscard]] constexpr bool pure(const ast_t::index_type index) {
+        for (auto next = static_cast<ast_t::index_type>(m_pure.size()); next <= index; ++next) {
+            const auto &node = m_result[next];
+            switch (node.m_kind) {
+                case ast_kind_t::unary:
+                    m_pure.push_back(m_pure[node.m_first]);
+                    break;
+                case ast_kind_t::binary:
+                    m_pure.push_back(node.m_operation != operation_t::div && m_pure[node.m_first] &&
+                                     m_pure[node.m_second]);
+                    break;
+                case ast_kind_t::assign:
+                    m_pure.push_back(false);
+                    break;
+                default:
+                    m_pure.push_back(true);
+                    break;
+            }
+        }
+        return m_pure[index];
+    }
+
+    // Whether two subtrees compute the same thing; compared pair by pair from an explicit stack.
+    [[nodiscard]] constexpr bool same(const ast_t::index_type a, const ast_t::index_type b) const {
+        std::vector<std::pair<ast_t::index_type, ast_t::index_type>> pending{{a, b}};
+        while (!pending.empty()) {
+            const auto [first, second] = pending.back();
+            pending.pop_back();
+            if (first == second) {
+                continue;
+            }
+            const auto &x = m_result[first];
+            const auto &y = m_result[second];
+            if (x.m_kind != y.m_kind || x.m_operation != y.m_operation) {
+                return false;
+            }
+            switch (x.m_kind) {
+                case ast_kind_t::constant:
+                    if (!is_constant(second, constant_value(first))) {
+                        return false;
+                    }
+                    break;
+                case ast_kind_t::variable:
+                    if (x.m_first != y.m_first) {
+                        return false;
+                    }
+                    break;
+                case ast_kind_t::unary:
+                    pending.emplace_back(x.m_first, y.m_first);
+                    break;
+                case ast_kind_t::binary:
+                    pending.emplace_back(x.m_second, y.m_second);
+                    pending.emplace_back(x.m_first, y.m_first);
+                    break;
+                case ast_kind_t::assign:
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr ast_t::index_type constant(const double value) {
+        return m_result.constant(value);
+    }
+
+    constexpr ast_t::index_type unary(const operation_t operation, const ast_t::index_type value) {
+        return m_result.unary(operation, value);
+    }
+
+    constexpr ast_t::index_type binary(const operation_t operation, const ast_t::index_type first,
+                                       const ast_t::index_type second) {
+        return m_result.binary(operation, first, second);
+    }
+
+private:
+    static constexpr auto unmapped = ~ast_t::index_type{0};
+
+    const ast_t *m_source = nullptr;
+    ast_t m_result;
+    std::vector<ast_t::index_type> m_mapping;
+    // pure() of the result's nodes so far
+    std::vector<bool> m_pure;
+
+    constexpr ast_t::index_type rebuild(const ast_node_t &node);
+
+    constexpr ast_t::index_type rewrite(ast_t::index_type index);
+
+    // Copies the nodes of the result reachable from its root into a fresh arena, keeping their order.
+    [[nodiscard]] constexpr ast_t compact() const {
+        const auto size = m_result.size();
+        const auto nodes = reachable(m_result);
+        ast_t ast;
+        std::vector<ast_t::index_type> mapping(size, unmapped);
+        for (ast_t::index_type index = 0; index < size; ++index) {
+            if (!nodes[index]) {
+                continue;
+            }
+            const auto &node = m_result[index];
+            switch (node.m_kind) {
+                case ast_kind_t::constant:
+                    mapping[index] = ast.constant(m_result.constant_value(node));
+                    break;
+                case ast_kind_t::variable:
+                    mapping[index] = ast.variable(node.m_first);
+                    break;
+                case ast_kind_t::unary:
+                    mapping[index] = ast.unary(node.m_operation, mapping[node.m_first]);
+                    break;
+                case ast_kind_t::binary:
+                    mapping[index] = ast.binary(node.m_operation, mapping[node.m_first], mapping[node.m_second]);
+                    break;
+                case ast_kind_t::assign:
+                    mapping[index] = ast.assign(node.m_operation, node.m_first, mapping[node.m_second]);
+                    break;
+            }
+        }
+        ast.m_root = mapping[m_result.m_root];
+        return ast;
+    }
+};
+
+// A power of two whose reciprocal is a normal double as well, so that dividing by it and multiplying by its
+// reciprocal round identically.
+[[nodiscard]] constexpr bool has_exact_reciprocal(const double value) noexcept {
+    const auto bits = std::bit_cast<std::uint64_t>(value);
+    const auto exponent = bits >> 52 & 0x7ff;
+    return (bits & ((std::uint64_t{1} << 52) - 1)) == 0 && exponent >= 1 && exponent <= 2045;
+}
+
+// Tried in order on every unary and binary node; earlier rules take precedence.
+inline constexpr std::array<simplify_rule_t, 15> simplify_rules{{
+        {"fold constants", false, [](simplify_pass_t &pass, const ast_node_t node) {
+            if (node.m_kind == ast_kind_t::unary && pass.is_constant(node.m_first)) {
+                const auto value = pass.constant_value(node.m_first);
+                return pass.constant(node.m_operation == operation_t::minus ? -value : value);
+            }
+            if (node.m_kind != ast_kind_t::binary || !pass.is_constant(node.m_first) ||
+                !pass.is_constant(node.m_second)) {
+                return simplify_pass_t::no_match;
+            }
+            const auto first = pass.constant_value(node.m_first);
+            const auto second = pass.constant_value(node.m_second);
+            switch (node.m_operation) {
+                case operation_t::plus:
+                    return pass.constant(first + second);
+                case operation_t::minus:
+                    return pass.constant(first - second);
+                case operation_t::mul:
+                    return pass.constant(first * second);
+                default:
+                    // a zero divisor has to throw when evaluated
+                    return second == 0 ? simplify_pass_t::no_match : pass.constant(first / second);
+            }
+        }},
+        {"+x = x", false, [](simplify_pass_t &, const ast_node_t node) {
+            return node.m_kind == ast_kind_t::unary && node.m_operation == operation_t::plus ? node.m_first
+                                                                                            : simplify_pass_t::no_match;
+        }},
+        {"-(-x) = x", false, [](simplify_pass_t &pass, const ast_node_t node) {
+            return node.m_kind == ast_kind_t::unary && node.m_operation == operation_t::minus &&
+                   pass.is_negation(node.m_first) ? pass.node(node.m_first).m_first : simplify_pass_t::no_match;
+        }},
+        {"x * 1 = 1 * x = x / 1 = x", false, [](simplify_pass_t &pass, const ast_node_t node) {
+            if (node.m_kind != ast_kind_t::binary) {
+                return simplify_pass_t::no_match;
+            }
+            if ((node.m_operation == operation_t::mul || node.m_operation == operation_t::div) &&
+                pass.is_constant(node.m_second, 1)) {
+                return node.m_first;
+            }
+            return node.m_operation == operation_t::mul && pass.is_constant(node.m_first, 1) ? node.m_second
+                                                                                            : simplify_pass_t::no_match;
+        }},
+        {"x + -0 = -0 + x = x - 0 = x", false, [](simplify_pass_t &pass, const ast_node_t node) {
+            if (node.m_kind != ast_kind_t::binary) {
+                return simplify_pass_t::no_match;
+            }
+            if ((node.m_operation == operation_t::plus && pass.is_constant(node.m_second, -0.0)) ||
+                (node.m_operation == operation_t::minus && pass.is_constant(node.m_second, 0.0))) {
+                return node.m_first;
+            }
+            return node.m_operation == operation_t::plus && pass.is_constant(node.m_first, -0.0)
+                   ? node.m_second : simplify_pass_t::no_match;
+        }},
+        {"x * -1 = -1 * x = x / -1 = -x", false, [](simplify_pass_t &pass, const ast_node_t node) {
+            if (node.m_kind != ast_kind_t::binary) {
+                return simplify_pass_t::no_match;
+            }
+            if ((node.m_operation == operation_t::mul || node.m_operation == operation_t::div) &&
+                pass.is_constant(node.m_second, -1)) {
+                return pass.unary(operation_t::minus, node.m_first);
+            }
+            return node.m_operation == operation_t::mul && pass.is_constant(node.m_first, -1)
+                   ? pass.unary(operation_t::minus, node.m_second) : simplify_pass_t::no_match;
+        }},
+        {"x + -y = x - y, x - -y = x + y", false, [](simplify_pass_t &pass, const ast_node_t node) {
+            if (node.m_kind != ast_kind_t::binary || !pass.is_negation(node.m_second)) {
+                return simplify_pass_t::no_match;
+            }
+            const auto y = pass.node(node.m_second).m_first;
+            switch (node.m_operation) {
+                case operation_t::plus:
+                    return pass.binary(operation_t::minus, node.m_first, y);
+                case operation_t::minus:
+                    return pass.binary(operation_t::plus, node.m_first, y);
+                default:
+                    return simplify_pass_t::no_match;
+            }
+        }},
+        {"-x * -y = x * y, -x / -y = x / y", false, [](simplify_pass_t &pass, const ast_node_t node) {
+            if (node.m_kind != ast_kind_t::binary ||
+                (node.m_operation != operation_t::mul && node.m_operation != operation_t::div) ||
+                !pass.is_negation(node.m_first) || !pass.is_negation(node.m_second)) {
+                return simplify_pass_t::no_match;
+            }
+            return pass.binary(node.m_operation, pass.node(node.m_first).m_first, pass.node(node.m_second).m_first);
+        }},
+        {"x / 2^k = x * 2^-k", false, [](simplify_pass_t &pass, const ast_node_t node) {
+            if (node.m_kind != ast_kind_t::binary || node.m_operation != operation_t::div ||
+                !pass.is_constant(node.m_second) || !has_exact_reciprocal(pass.constant_value(node.m_second))) {
+                return simplify_pass_t::no_match;
+            }
+            return pass.binary(operation_t::mul, node.m_first, pass.constant(1 / pass.constant_value(node.m_second)));
+        }},
+        {"x * 2 = 2 * x = x + x", false, [](simplify_pass_t &pass, const ast_node_t node) {
+            if (node.m_kind != ast_kind_t::binary || node.m_operation != operation_t::mul) {
+                return simplify_pass_t::no_match;
+            }
+            // only for variables: a larger operand would be evaluated twice by the tree walkers
+            const auto variable = [&pass](const ast_t::index_type index) {
+                return pass.node(index).m_kind == ast_kind_t::variable;
+            };
+            if (variable(node.m_first) && pass.is_constant(node.m_second, 2)) {
+                return pass.binary(operation_t::plus, node.m_first, node.m_first);
+            }
+            return variable(node.m_second) && pass.is_constant(node.m_first, 2)
+                   ? pass.binary(operation_t::plus, node.m_second, node.m_second) : simplify_pass_t::no_match;
+        }},
+        {"-x * c = x * -c", false, [](simplify_pass_t &pass, const ast_node_t node) {
+            if (node.m_kind != ast_kind_t::binary || node.m_operation != operation_t::mul ||
+                !pass.is_negation(node.m_first) || !pass.is_constant(node.m_second)) {
+                return simplify_pass_t::no_match;
+            }
+            return pass.binary(operation_t::mul, pass.node(node.m_first).m_first,
+                               pass.constant(-pass.constant_value(node.m_second)));
+        }},
+        {"x + 0 = 0 + x = x", true, [](simplify_pass_t &pass, const ast_node_t node) {
+            if (node.m_kind != ast_kind_t::binary) {
+                return simplify_pass_t::no_match;
+            }
+            if ((node.m_operation == operation_t::plus || node.m_operation == operation_t::minus) &&
+                (pass.is_constant(node.m_second, 0.0) || pass.is_constant(node.m_second, -0.0))) {
+                return node.m_first;
+            }
+            return node.m_operation == operation_t::plus &&
+                   (pass.is_constant(node.m_first, 0.0) || pass.is_constant(node.m_first, -0.0))
+                   ? node.m_second : simplify_pass_t::no_match;
+        }},
+        {"x - x = 0", true, [](simplify_pass_t &pass, const ast_node_t node) {
+            return node.m_kind == ast_kind_t::binary && node.m_operation == operation_t::minus &&
+                   pass.same(node.m_first, node.m_second) && pass.pure(node.m_first) ? pass.constant(0)
+                                                                                     : simplify_pass_t::no_match;
+        }},
+        {"x * 0 = 0 * x = 0", true, [](simplify_pass_t &pass, const ast_node_t node) {
+            if (node.m_kind != ast_kind_t::binary || node.m_operation != operation_t::mul) {
+                return simplify_pass_t::no_match;
+            }
+            const auto zero = [&pass](const ast_t::index_type index) {
+                return pass.is_constant(index) && pass.constant_value(index) == 0;
+            };
+            if ((zero(node.m_first) && pass.pure(node.m_second)) || (zero(node.m_second) && pass.pure(node.m_first))) {
+                return pass.constant(0);
+            }
+            return simplify_pass_t::no_match;
+        }},
+        {"x / c = x * (1 / c)", true, [](simplify_pass_t &pass, const ast_node_t node) {
+            if (node.m_kind != ast_kind_t::binary || node.m_operation != operation_t::div ||
+                !pass.is_constant(node.m_second)) {
+                return simplify_pass_t::no_match;
+            }
+            const auto divisor = pass.constant_value(node.m_second);
+            const auto reciprocal = 1 / divisor;
+            // a zero divisor must still throw, and a reciprocal that overflows would turn finite results infinite
+            if (divisor == 0 || reciprocal - reciprocal != 0) {
+                return simplify_pass_t::no_match;
+            }
+            return pass.binary(operation_t::mul, node.m_first, pass.constant(reciprocal));
+        }},
+}};
+
+constexpr ast_t simplify_pass_t::run(const ast_t &ast) {
+    m_source = &ast;
+    m_result = ast_t{};
+    m_mapping.assign(ast.size(), unmapped);
+    m_pure.clear();
+
+    // children precede their parents, so one forward sweep rebuilds every node after its operands without recursing
+    const auto nodes = reachable(ast);
+    for (ast_t::index_type index = 0; index < ast.size(); ++index) {
+        if (nodes[index]) {
+            m_mapping[index] = rebuild(ast[index]);
+        }
+    }
+    m_result.m_root = m_mapping[ast.m_root];
+    auto result = compact();
+    m_stats.m_nodes_before += reachable_nodes(ast);
+    m_stats.m_nodes_after += result.size();
+    m_result.clear();
+    return result;
+}
+
+constexpr ast_t::index_type simplify_pass_t::rebuild(const ast_node_t &node) {
+    switch (node.m_kind) {
+        case ast_kind_t::constant:
+            return m_result.constant(m_source->constant_value(node));
+        case ast_kind_t::variable:
+            return m_result.variable(node.m_first);
+        case ast_kind_t::unary:
+            return rewrite(m_result.unary(node.m_operation, m_mapping[node.m_first]));
+        case ast_kind_t::binary:
+            return rewrite(m_result.binary(node.m_operation, m_mapping[node.m_first], m_mapping[node.m_second]));
+        case ast_kind_t::assign:
+            return m_result.assign(node.m_operation, node.m_first, m_mapping[node.m_second]);
+    }
+    return unmapped;
+}
+
+// Applies rules to a freshly built node, and then to whatever replaced it, until none matches.
+constexpr ast_t::index_type simplify_pass_t::rewrite(ast_t::index_type index) {
+    for (bool changed = true; changed;) {
+        changed = false;
+        const auto kind = m_result[index].m_kind;
+        if (kind != ast_kind_t::unary && kind != ast_kind_t::binary) {
+            break;
+        }
+        for (const auto &rule: simplify_rules) {
+            if (rule.m_fast_math && !m_options.m_fast_math) {
+                continue;
+            }
+            // by value: the rule may grow the arena
+            if (const auto replacement = rule.m_apply(*this, m_result[index]); replacement != no_match) {
+                index = replacement;
+                ++m_stats.m_rewrites;
+                changed = true;
+                break;
+            }
+        }
+    }
+    return index;
+}
+
+[[nodiscard]] constexpr ast_t simplify(const ast_t &ast, const simplify_options_t &options = {}) {
+    simplify_pass_t pass{options};
+    return pass.run(ast);
+}
+
+// Expression templates are simplified through their runtime form; in a constant expression this happens entirely
+// at compile time.
+template<Node T>
+[[nodiscard]] constexpr ast_t simplify(const T &node, const simplify_options_t &options = {}) {
+    return simplify(to_ast(node), options);
+}
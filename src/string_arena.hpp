@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*
+ * Append-only storage for many short strings: each store() copies the text into the current chunk, so names sit
+ * next to each other in memory and cost no allocation of their own. A view returned by store() stays valid for as
+ * long as the arena or any copy of it exists, even after the arena has been moved.
+ *
+ * Copies share the chunks instead of copying the text, which is what makes copying a symbol table cheap. A copy
+ * never writes into a shared chunk: it starts a fresh chunk on its first store(), and the original only ever
+ * writes past the bytes the copy can see.
+ */
+struct string_arena_t {
+    static constexpr std::size_t chunk_size = 4096;
+
+    string_arena_t() = default;
+
+    string_arena_t(const string_arena_t &other) : m_chunks(other.m_chunks), m_bytes(other.m_bytes) {}
+
+    string_arena_t(string_arena_t &&other) noexcept
+            : m_chunks(std::move(other.m_chunks)), m_next(std::exchange(other.m_next, nullptr)),
+              m_free(std::exchange(other.m_free, 0)), m_bytes(std::exchange(other.m_bytes, 0)) {}
+
+    string_arena_t &operator=(string_arena_t other) noexcept {
+        std::swap(m_chunks, other.m_chunks);
+        std::swap(m_next, other.m_next);
+        std::swap(m_free, other.m_free);
+        std::swap(m_bytes, other.m_bytes);
+        return *this;
+    }
+
+    ~string_arena_t() = default;
+
+    // A copy of `text` owned by the arena.
+    [[nodiscard]] std::string_view store(const std::string_view text) {
+        if (text.empty()) {
+            return {};
+        }
+        char *destination;
+        if (text.size() <= m_free) {
+            destination = m_next;
+            m_next += text.size();
+            m_free -= text.size();
+        } else if (text.size() > chunk_size / 4) {
+            // long texts get a chunk of their own, so the current chunk's free space is not wasted
+            destination = allocate(text.size());
+        } else {
+            destination = allocate(chunk_size);
+            m_next = destination + text.size();
+            m_free = chunk_size - text.size();
+        }
+        std::memcpy(destination, text.data(), text.size());
+        m_bytes += text.size();
+        return {destination, text.size()};
+    }
+
+    // Total length of the texts stored.
+    [[nodiscard]] std::size_t bytes() const noexcept {
+        return m_bytes;
+    }
+
+    [[nodiscard]] std::size_t chunks() const noexcept {
+        return m_chunks.size();
+    }
+
+private:
+    std::vector<std::shared_ptr<char[]>> m_chunks;
+    // unused tail of the last chunk; empty in a copy until it allocates a chunk of its own
+    char *m_next = nullptr;
+    std::size_t m_free = 0;
+    std::size_t m_bytes = 0;
+
+    [[nodiscard]] char *allocate(const std::size_t size) {
+        m_chunks.push_back(std::shared_ptr<char[]>(new char[size]));
+        return m_chunks.back().get();
+    }
+};
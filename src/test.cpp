@@ -2,7 +2,27 @@
 
 #include <doctest/doctest.h>
 
+#include <cmath>
+#include <cstdint>
+#include <limits>
 #include <sstream>
+#include <type_traits>
+
+// Nodes are plain aggregates of their operands: no vptr, so they can be memcpy'd into batch jobs.
+struct binary_payload_t {
+    operation_t m_operation;
+    double m_first;
+    std::size_t m_second;
+};
+
+static_assert(std::is_trivially_copyable_v<constant_t>);
+static_assert(std::is_trivially_copyable_v<variable_t>);
+static_assert(std::is_trivially_copyable_v<unary_t<variable_t>>);
+static_assert(std::is_trivially_copyable_v<binary_t<constant_t, variable_t>>);
+static_assert(std::is_trivially_copyable_v<assign_t<binary_t<variable_t, constant_t>>>);
+static_assert(sizeof(constant_t) == sizeof(double));
+static_assert(sizeof(variable_t) == sizeof(std::size_t));
+static_assert(sizeof(binary_t<constant_t, variable_t>) == sizeof(binary_payload_t));
 
 constexpr void check_binary() {
     state_t state = std::vector{2.0, 3.0, 0.0};
@@ -16,6 +36,18 @@ constexpr void check_binary() {
 
 }
 
+// Constant-only subtrees are folded into a single constant_t when the expression is built.
+static_assert(std::is_same_v<decltype(constant_t(2.0) + 4.0), constant_t>);
+static_assert(std::is_same_v<decltype(-(constant_t(2.0) * 4.0)), constant_t>);
+static_assert(std::is_same_v<decltype(+constant_t(2.0)), constant_t>);
+static_assert(std::is_same_v<decltype(std::declval<variable_t>() * (constant_t(2.0) + 4.0)),
+        binary_t<variable_t, constant_t>>);
+static_assert((constant_t(2.0) + 4.0).m_value == 6);
+static_assert((constant_t(2.0) - 4.0).m_value == -2);
+static_assert((constant_t(2.0) * 4.0).m_value == 8);
+static_assert((constant_t(2.0) / 4.0).m_value == 0.5);
+static_assert((-(constant_t(2.0) + 4.0) / 3).m_value == -2);
+
 TEST_CASE("Calculate")
 {
     auto sys = symbol_table_t{};
@@ -72,6 +104,21 @@ TEST_CASE("Calculate")
         CHECK((a / b)(state) == 2. / 3);
         CHECK_THROWS_MESSAGE((a / c)(state), "division by zero");
     }
+    SUBCASE("Error policies for division by zero")
+    {
+        CHECK_THROWS_MESSAGE((a / c)(state, throw_on_error_t{}), "division by zero");
+        CHECK((a / c)(state, ieee_errors_t{}) == std::numeric_limits<double>::infinity());
+        CHECK(std::isnan((c / c)(state, ieee_errors_t{})));
+
+        bool error = false;
+        CHECK((a / b)(state, sticky_error_t{error}) == 2. / 3);
+        CHECK_FALSE(error);
+        CHECK((-a / c + a)(state, sticky_error_t{error}) == -std::numeric_limits<double>::infinity());
+        CHECK(error);
+        // the flag stays raised until the caller clears it
+        CHECK((a / b)(state, sticky_error_t{error}) == 2. / 3);
+        CHECK(error);
+    }
     SUBCASE("Mixed addition and multiplication")
     {
         CHECK((a + a * b)(state) == 8);
@@ -82,6 +129,13 @@ TEST_CASE("Calculate")
         CHECK((7 + a)(state) == 9);
         CHECK((a - 7)(state) == -5);
     }
+    SUBCASE("Constant folding")
+    {
+        CHECK((a * (constant_t(2.0) + 4.0))(state) == 12);
+        CHECK((constant_t(1.0) / 0.0).m_value == std::numeric_limits<double>::infinity());
+        CHECK((constant_t(-1.0) / 0.0).m_value == -std::numeric_limits<double>::infinity());
+        CHECK(std::isnan((constant_t(0.0) / 0.0).m_value));
+    }
     SUBCASE("Store expression and evaluate lazily")
     {
         auto expr = (a + b) * c;
@@ -112,4 +166,137 @@ TEST_CASE("Calculate")
             CHECK(ss.str() == "a+2");
         }
     }
-}
\ No newline at end of file
+}
+TEST_CASE("Value types")
+{
+    SUBCASE("float")
+    {
+        auto sys = basic_symbol_table_t<float>{};
+        auto a = sys.variable("a", 1.5f);
+        auto b = sys.variable("b", 0.25f);
+        auto &state = sys.m_state;
+
+        static_assert(std::is_same_v<decltype((a + b)(state)), float>);
+        CHECK((a * b + 0.5)(state) == 0.875f);
+        CHECK((a += b * 2)(state) == 2.0f);
+        CHECK((a + basic_constant_t{0.1f})(state) == 2.0f + 0.1f);
+    }
+    SUBCASE("int64_t evaluates exactly")
+    {
+        auto sys = basic_symbol_table_t<std::int64_t>{};
+        auto cents = sys.variable("cents", 9'007'199'254'740'993);
+        auto count = sys.variable("count", 3);
+        auto &state = sys.m_state;
+
+        // 2^53 + 1 is not representable as a double
+        CHECK((cents + count - count)(state) == 9'007'199'254'740'993);
+        CHECK((cents / count)(state) == 3'002'399'751'580'331);
+        CHECK((cents *= 2)(state) == 18'014'398'509'481'986);
+        CHECK((cents - cents)(state) == 0);
+        CHECK_THROWS_MESSAGE((count / (count - count))(state), "division by zero");
+        // integers have no inf, so a division by zero that is let through yields zero
+        CHECK((count / (count - count))(state, ieee_errors_t{}) == 0);
+    }
+    SUBCASE("long double")
+    {
+        auto sys = basic_symbol_table_t<long double>{};
+        auto a = sys.variable("a", 1);
+        auto &state = sys.m_state;
+
+        // 2^-60 is lost next to 1 in a double but not in x87 extended precision
+        const auto expr = (a + basic_constant_t{0x1p-60L}) - a;
+        if constexpr (std::numeric_limits<long double>::digits >= 64) {
+            CHECK(expr(state) == 0x1p-60L);
+        }
+        std::stringstream ss;
+        ss << printer{sys, a / 2};
+        CHECK(ss.str() == "a/2");
+    }
+}
+
+TEST_CASE("Symbol table name lookup")
+{
+    auto sys = symbol_table_t{};
+    const auto a = sys.variable("a", 1);
+    const auto b = sys.variable("b", 2);
+
+    CHECK(sys.find("a") == a.m_id);
+    CHECK(sys.find("b") == b.m_id);
+    CHECK(sys.find("c") == symbol_table_t::npos);
+    CHECK(sys.find("") == symbol_table_t::npos);
+    CHECK_THROWS_MESSAGE((void) sys.variable("a", 3), "duplicate variable 'a'");
+    CHECK(sys.m_names.size() == 2);
+
+    SUBCASE("get_or_create")
+    {
+        CHECK(sys.get_or_create("b", 5).m_id == b.m_id);
+        CHECK(sys.m_state[b.m_id] == 2);
+        const auto c = sys.get_or_create("c", 5);
+        CHECK(c.m_id == 2);
+        CHECK(sys.m_state[c.m_id] == 5);
+        CHECK(sys.find("c") == c.m_id);
+    }
+    SUBCASE("Every name is found after the index grows")
+    {
+        for (std::size_t id = 2; id < 10'000; ++id) {
+            (void) sys.variable("v" + std::to_string(id), 0);
+        }
+        std::size_t found = 0;
+        for (std::size_t id = 2; id < 10'000; ++id) {
+            found += sys.find("v" + std::to_string(id)) == id;
+        }
+        CHECK(found == 9'998);
+        CHECK(sys.find("v10000") == symbol_table_t::npos);
+    }
+    SUBCASE("Copies keep their own index")
+    {
+        auto copy = sys;
+        (void) copy.variable("c", 0);
+        CHECK(copy.find("c") == 2);
+        CHECK(sys.find("c") == symbol_table_t::npos);
+    }
+}
+
+// The whole evaluation happens at compile time when the symbol table is static.
+static_assert([] {
+    static_symbol_table_t<3> sys{{"a", "b", "c"}, {2.0, 3.0, 0.0}};
+    constexpr auto a = decltype(sys)::variable<0>();
+    constexpr auto b = decltype(sys)::variable<1>();
+    constexpr auto c = decltype(sys)::variable<2>();
+    auto state = sys.m_state;
+    const auto value = ((c <<= a * b) + c / a)(state);
+    return value + state[2];
+}() == 15);
+
+TEST_CASE("Static symbol table")
+{
+    static_symbol_table_t<3> sys{{"a", "b", "c"}, {2.0, 3.0, 0.0}};
+    const auto a = sys.variable<0>();
+    const auto b = sys.variable<1>();
+    const auto c = sys.variable<2>();
+    auto state = sys.m_state;
+
+    static_assert(std::is_same_v<decltype(state), std::array<double, 3>>);
+    static_assert(std::is_empty_v<static_variable_t<0>>);
+
+    CHECK(sys.name(1) == "b");
+    CHECK((a + b * c)(state) == 2);
+    CHECK((c += a / b)(state) == 2. / 3);
+    CHECK(state[2] == 2. / 3);
+    CHECK_THROWS_MESSAGE((a / (b - 3))(state), "division by zero");
+
+    SUBCASE("Mixes with runtime variables")
+    {
+        const variable_t runtime_b{1};
+        CHECK((a * runtime_b)(state) == 6);
+        CHECK((runtime_b <<= a + 1)(state) == 3);
+    }
+    SUBCASE("Other value types")
+    {
+        static_symbol_table_t<2, float> floats{{"x", "y"}, {1.5f, 2.0f}};
+        auto float_state = floats.m_state;
+        const auto x = floats.variable<0>();
+        const auto y = floats.variable<1>();
+        CHECK((x * y - 1)(float_state) == 2.0f);
+    }
+}
@@ -0,0 +1,99 @@
+#include "ast.hpp"
+
+#include <doctest/doctest.h>
+
+#include <string>
+
+TEST_CASE("Arena AST")
+{
+    auto sys = symbol_table_t{};
+    auto a = sys.variable("a", 2);
+    auto b = sys.variable("b", 3);
+    auto c = sys.variable("c", 0);
+
+    auto &state = sys.m_state;
+
+    SUBCASE("Nodes are small and refer to each other by index")
+    {
+        static_assert(std::is_trivially_copyable_v<ast_node_t>);
+        static_assert(sizeof(ast_node_t) == 16);
+
+        auto ast = to_ast((a + b) * c);
+        CHECK(ast.size() == 5);
+        CHECK(ast.m_root == 4);
+        CHECK(ast[ast.m_root] == ast_node_t{ast_kind_t::binary, operation_t::mul, 2, 3});
+    }
+    SUBCASE("Evaluation matches the expression tree")
+    {
+        const auto check = [&](const auto &expr) {
+            auto expected = state;
+            CHECK(to_ast(expr)(state) == expr(expected));
+            CHECK(state == expected);
+        };
+        check(a);
+        check(constant_t(4.0));
+        check(-b);
+        check(+b);
+        check(a + b * c);
+        check(a - (b - (c * (a + b))));
+        check(a / b);
+        check(c <<= b - a);
+        check(c += b - a * c);
+        check(c -= a);
+        check(c *= a);
+        check(c /= a);
+        CHECK_THROWS_MESSAGE(to_ast(a / c)(state), "division by zero");
+    }
+    SUBCASE("Parsing")
+    {
+        auto ast = parse_ast("c += (a + 0.5) * -b", sys);
+        auto expected = state;
+        CHECK(ast(state) == (c += (a + 0.5) * -b)(expected));
+        CHECK(state == expected);
+    }
+    SUBCASE("Lowering to bytecode")
+    {
+        const auto ast = to_ast(c += (a + 0.5) * -b);
+        CHECK(compile(ast).m_registers == compile(c += (a + 0.5) * -b).m_registers);
+        auto expected = state;
+        CHECK(run(compile(ast), state) == ast(expected));
+        CHECK(state == expected);
+    }
+    SUBCASE("Long chains are evaluated without deep recursion")
+    {
+        std::string sum = "a";
+        for (int i = 0; i < 1'000'000; ++i) {
+            sum += "+a";
+        }
+        CHECK(parse_ast(sum, sys)(state) == 2'000'002);
+
+        std::string mixed = "c <<= b";
+        constexpr const char *terms[] = {"+a*1.5", "-b/2", "*0.5", "-a", "/b"};
+        for (int i = 0; i < 100'000; ++i) {
+            mixed += terms[i % 5];
+        }
+        const auto ast = parse_ast(mixed, sys);
+        auto expected = state;
+        CHECK(ast(state) == run(compile(ast), expected));
+        CHECK(state == expected);
+
+        // the division sits below the depth where the walk stops recursing; its dividend assigns before it throws
+        std::string failing = "(c <<= 1) / (b - 3)";
+        for (int i = 0; i < 100'000; ++i) {
+            failing += "+a";
+        }
+        state[c.m_id] = 0;
+        CHECK_THROWS_MESSAGE((void) parse_ast(failing, sys)(state), "division by zero");
+        CHECK(state[c.m_id] == 1);
+    }
+    SUBCASE("Clearing keeps the arena")
+    {
+        auto ast = to_ast(a + b * c);
+        const auto capacity = ast.m_nodes.capacity();
+        ast.clear();
+        CHECK(ast.size() == 0);
+        CHECK(ast.m_nodes.capacity() == capacity);
+        ast.m_root = ast.binary(operation_t::minus, ast.variable(b.m_id), ast.constant(1));
+        CHECK(ast(state) == 2);
+    }
+}
@@ -0,0 +1,92 @@
+#include "batch.hpp"
+
+#include <doctest/doctest.h>
+
+#include <limits>
+
+TEST_CASE("Batch evaluation")
+{
+    auto sys = symbol_table_t{};
+    auto a = sys.variable("a", 2);
+    auto b = sys.variable("b", 3);
+    auto c = sys.variable("c", 0);
+
+    // more rows than a single block so the block loop and the tail are both exercised
+    constexpr std::size_t rows = 1000;
+    auto batch = batch_t{sys, rows};
+    for (std::size_t i = 0; i < rows; ++i) {
+        batch.column(a)[i] = static_cast<double>(i);
+        batch.column(c)[i] = static_cast<double>(i % 7) + 1;
+    }
+
+    // evaluates the same expression row by row through eval_visitor_t
+    const auto expected = [&](const auto &expr) {
+        auto copy = batch;
+        std::vector<double> result(rows);
+        for (std::size_t i = 0; i < rows; ++i) {
+            state_t state{copy.column(a)[i], copy.column(b)[i], copy.column(c)[i]};
+            result[i] = expr(state);
+            copy.column(a)[i] = state[0];
+            copy.column(b)[i] = state[1];
+            copy.column(c)[i] = state[2];
+        }
+        return std::pair{result, copy};
+    };
+
+    SUBCASE("Initial values are broadcast to every row")
+    {
+        auto fresh = batch_t{sys, 3};
+        CHECK(fresh.column(b)[0] == 3);
+        CHECK(fresh.column(b)[2] == 3);
+    }
+    SUBCASE("Variables and constants")
+    {
+        CHECK(batch_eval(a, batch) == expected(a).first);
+        CHECK(batch_eval(constant_t(4.0), batch) == std::vector<double>(rows, 4.0));
+    }
+    SUBCASE("Unary operations")
+    {
+        CHECK(batch_eval(-a, batch) == expected(-a).first);
+        CHECK(batch_eval(+c, batch) == expected(+c).first);
+    }
+    SUBCASE("Binary operations")
+    {
+        CHECK(batch_eval(a + b, batch) == expected(a + b).first);
+        CHECK(batch_eval(a - 7, batch) == expected(a - 7).first);
+        CHECK(batch_eval(7 * a, batch) == expected(7 * a).first);
+        CHECK(batch_eval((a + b) * c, batch) == expected((a + b) * c).first);
+        CHECK(batch_eval(a - b / c, batch) == expected(a - b / c).first);
+        CHECK(batch_eval(a - (b - (c * (a + b))), batch) == expected(a - (b - (c * (a + b)))).first);
+    }
+    SUBCASE("Assignments write every row")
+    {
+        const auto [result, after] = expected(c += b - a * c);
+        CHECK(batch_eval(c += b - a * c, batch) == result);
+        CHECK(batch.m_data == after.m_data);
+    }
+    SUBCASE("An assignment does not clobber an operand that was already read")
+    {
+        const auto [result, after] = expected(a + (a <<= 1));
+        CHECK(batch_eval(a + (a <<= 1), batch) == result);
+        CHECK(batch.m_data == after.m_data);
+    }
+    SUBCASE("Division by zero in any row")
+    {
+        batch.column(c)[rows - 1] = 0;
+        CHECK_THROWS_MESSAGE(batch_eval(a / c, batch), "division by zero");
+
+        const auto result = batch_eval(a / c, batch, simd_kernels(), ieee_errors_t{});
+        CHECK(result[rows - 1] == std::numeric_limits<double>::infinity());
+        CHECK(result[rows - 2] == batch.column(a)[rows - 2] / batch.column(c)[rows - 2]);
+
+        bool error = false;
+        CHECK(batch_eval(a / c, batch, simd_kernels(), sticky_error_t{error}) == result);
+        CHECK(error);
+    }
+    SUBCASE("The sticky flag stays clear without a zero divisor")
+    {
+        bool error = false;
+        CHECK(batch_eval(a / c - b / 2, batch, simd_kernels(), sticky_error_t{error}) == expected(a / c - b / 2).first);
+        CHECK_FALSE(error);
+    }
+}
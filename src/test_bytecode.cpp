@@ -0,0 +1,128 @@
+#include "bytecode.hpp"
+
+#include <doctest/doctest.h>
+
+#include <cstdint>
+#include <limits>
+#include <sstream>
+
+TEST_CASE("Bytecode")
+{
+    auto sys = symbol_table_t{};
+    auto a = sys.variable("a", 2);
+    auto b = sys.variable("b", 3);
+    auto c = sys.variable("c", 0);
+
+    auto &state = sys.m_state;
+    vm_t vm;
+
+    SUBCASE("Evaluation matches the expression tree")
+    {
+        CHECK(vm.run(compile(a), state) == a(state));
+        CHECK(vm.run(compile(constant_t(4.0)), state) == 4);
+        CHECK(vm.run(compile(-b), state) == (-b)(state));
+        CHECK(vm.run(compile(+b), state) == (+b)(state));
+        CHECK(vm.run(compile(a + b), state) == (a + b)(state));
+        CHECK(vm.run(compile(a - 7), state) == (a - 7)(state));
+        CHECK(vm.run(compile(7 * a), state) == (7 * a)(state));
+        CHECK(vm.run(compile(a / b), state) == (a / b)(state));
+        CHECK(vm.run(compile(a - (b - (c * (a + b)))), state) == (a - (b - (c * (a + b))))(state));
+    }
+    SUBCASE("Assignments")
+    {
+        auto expected = state;
+        CHECK(vm.run(compile(c <<= b - a), state) == (c <<= b - a)(expected));
+        CHECK(vm.run(compile(c += b - a * c), state) == (c += b - a * c)(expected));
+        CHECK(vm.run(compile(c -= a), state) == (c -= a)(expected));
+        CHECK(vm.run(compile(c *= a), state) == (c *= a)(expected));
+        CHECK(vm.run(compile(c /= a), state) == (c /= a)(expected));
+        CHECK(state == expected);
+    }
+    SUBCASE("Operands are evaluated left to right, as by eval_visitor_t")
+    {
+        // the dividend reads a before the divisor assigns it: 2 / 4
+        auto expected = state;
+        const auto expr = a / (a <<= 4);
+        CHECK(expr(expected) == 0.5);
+        CHECK(vm.run(compile(expr), state) == 0.5);
+        CHECK(state == expected);
+
+        // a dividend that assigns has done so by the time a zero divisor throws
+        CHECK_THROWS_MESSAGE((void) ((c += 1) / (a - a))(expected), "division by zero");
+        CHECK_THROWS_MESSAGE((void) vm.run(compile((c += 1) / (a - a)), state), "division by zero");
+        CHECK(expected[c.m_id] == 1);
+        CHECK(state == expected);
+    }
+    SUBCASE("Registers are allocated as a stack")
+    {
+        CHECK(compile(a + b).m_registers == 2);
+        CHECK(compile((a + b) + c).m_registers == 2);
+        CHECK(compile(a + (b + c)).m_registers == 3);
+    }
+    SUBCASE("Equal constants share a slot")
+    {
+        const auto program = compile(a * 2 + b * 2);
+        CHECK(program.m_constants == std::vector{2.0});
+    }
+    SUBCASE("Division by zero")
+    {
+        CHECK_THROWS_MESSAGE(run(compile(a / c), state), "division by zero");
+    }
+    SUBCASE("The state must cover every variable")
+    {
+        state_t small{1.0};
+        CHECK_THROWS_AS(run(compile(a + c), small), std::out_of_range);
+    }
+    SUBCASE("Serialisation round trip")
+    {
+        const auto program = compile(c += (a + 0.5) * -b);
+        std::stringstream ss;
+        serialize(ss, program);
+        const auto copy = deserialize(ss);
+        CHECK(copy == program);
+        auto expected = state;
+        CHECK(run(copy, state) == (c += (a + 0.5) * -b)(expected));
+    }
+    SUBCASE("Malformed programs are rejected")
+    {
+        std::stringstream garbage{"nope"};
+        CHECK_THROWS_AS((void) deserialize(garbage), std::runtime_error);
+
+        auto program = compile(a + b);
+        program.m_code.back().m_target = program.m_registers;
+        std::stringstream ss;
+        serialize(ss, program);
+        CHECK_THROWS_MESSAGE((void) deserialize(ss), "malformed program");
+
+        std::stringstream truncated;
+        serialize(truncated, compile(a + b));
+        auto bytes = truncated.str();
+        bytes.pop_back();
+        std::stringstream cut{bytes};
+        CHECK_THROWS_MESSAGE((void) deserialize(cut), "truncated program");
+    }
+    SUBCASE("Untrusted counts are not allocated up front")
+    {
+        const auto header = [](const std::uint32_t registers, const std::uint64_t constants) {
+            std::stringstream ss;
+            ss.write(program_magic, sizeof(program_magic));
+            write_raw(ss, registers);
+            write_raw(ss, std::uint32_t{2});
+            write_raw(ss, constants);
+            return ss;
+        };
+        auto huge_constants = header(1, std::uint64_t{1} << 40);
+        CHECK_THROWS_MESSAGE((void) deserialize(huge_constants), "truncated program");
+
+        auto huge_code = header(1, 0);
+        write_raw(huge_code, ~std::uint64_t{0});
+        CHECK_THROWS_MESSAGE((void) deserialize(huge_code), "truncated program");
+
+        // a valid program claiming far more registers than it uses
+        auto program = compile(a + b);
+        program.m_registers = std::numeric_limits<std::uint32_t>::max();
+        std::stringstream ss;
+        serialize(ss, program);
+        CHECK_THROWS_MESSAGE((void) deserialize(ss), "malformed program");
+    }
+}
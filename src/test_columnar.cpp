@@ -0,0 +1,133 @@
+#include "columnar.hpp"
+
+#include <doctest/doctest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+// A file in the temporary directory, removed again when the test is done.
+struct temporary_file_t {
+    std::filesystem::path m_path;
+
+    explicit temporary_file_t(const std::string &name)
+            : m_path(std::filesystem::temp_directory_path() / ("dsl2_" + name)) {}
+
+    ~temporary_file_t() {
+        std::filesystem::remove(m_path);
+    }
+};
+
+static void write_column_file(const std::filesystem::path &path, const std::vector<std::string> &names,
+                              const std::vector<std::vector<double>> &columns) {
+    column_file_writer_t writer{path, names, columns.empty() ? 0 : columns.front().size()};
+    for (const auto &column: columns) {
+        writer.append(column);
+    }
+    writer.finish();
+}
+
+TEST_CASE("Column files")
+{
+    const temporary_file_t file{"columns.bin"};
+    constexpr std::size_t rows = 1000;
+    std::vector<double> x(rows);
+    std::vector<double> y(rows);
+    for (std::size_t i = 0; i < rows; ++i) {
+        x[i] = static_cast<double>(i);
+        y[i] = static_cast<double>(i % 7) + 1;
+    }
+    write_column_file(file.m_path, {"x", "longer name"}, {x, y});
+
+    SUBCASE("Round trip")
+    {
+        const column_file_t input{file.m_path};
+        CHECK(input.rows() == rows);
+        REQUIRE(input.columns() == 2);
+        CHECK(input.name(1) == "longer name");
+        CHECK(input.find("x") == 0);
+        CHECK(input.find("y") == column_file_t::npos);
+        std::vector<double> values(10);
+        input.read(1, 990, values);
+        CHECK(values == std::vector(y.begin() + 990, y.end()));
+        CHECK_THROWS_AS(input.read(1, 991, values), std::out_of_range);
+    }
+    SUBCASE("Malformed files")
+    {
+        const temporary_file_t bad{"bad.bin"};
+        std::ofstream{bad.m_path, std::ios::binary} << "not columns";
+        CHECK_THROWS_MESSAGE(column_file_t{bad.m_path}, "not a column file");
+        std::filesystem::resize_file(file.m_path, std::filesystem::file_size(file.m_path) - 8);
+        CHECK_THROWS_MESSAGE(column_file_t{file.m_path}, "truncated column file");
+        CHECK_THROWS_AS(column_file_t{"/nonexistent/columns.bin"}, std::runtime_error);
+    }
+    SUBCASE("The writer checks its value count")
+    {
+        const temporary_file_t short_file{"short.bin"};
+        column_file_writer_t writer{short_file.m_path, {"x"}, 3};
+        writer.append(std::vector{1.0, 2.0});
+        CHECK_THROWS_AS(writer.append(std::vector{3.0, 4.0}), std::length_error);
+        CHECK_THROWS_AS(writer.finish(), std::length_error);
+    }
+}
+
+TEST_CASE("Streaming evaluation")
+{
+    auto sys = symbol_table_t{};
+    auto a = sys.variable("a", 2);
+    auto b = sys.variable("b", 3);
+    auto c = sys.variable("c", 0.5);
+
+    constexpr std::size_t rows = 10'000;
+    std::vector<double> a_values(rows);
+    std::vector<double> c_values(rows);
+    for (std::size_t i = 0; i < rows; ++i) {
+        a_values[i] = static_cast<double>(i);
+        c_values[i] = static_cast<double>(i % 5) + 1;
+    }
+    // "b" has no column, so every row uses its initial value; "unused" is not a variable
+    const temporary_file_t input_file{"stream_in.bin"};
+    write_column_file(input_file.m_path, {"c", "unused", "a"}, {c_values, std::vector<double>(rows, 9), a_values});
+    const column_file_t input{input_file.m_path};
+    const temporary_file_t output_file{"stream_out.bin"};
+
+    // the whole input as one batch
+    batch_t batch{sys, rows};
+    std::ranges::copy(a_values, batch.column(a).begin());
+    std::ranges::copy(c_values, batch.column(c).begin());
+
+    const auto result = [&] {
+        const column_file_t output{output_file.m_path};
+        REQUIRE(output.columns() == 1);
+        std::vector<double> values(output.rows());
+        output.read(0, 0, values);
+        return std::pair{std::string{output.name(0)}, values};
+    };
+
+    SUBCASE("Chunks of any size give the same column as one batch")
+    {
+        const auto expr = (a + b) * c - a / c;
+        const auto expected = batch_eval(expr, batch);
+        for (const std::size_t chunk_rows: {std::size_t{1000}, std::size_t{777}, rows, stream_chunk_rows}) {
+            CHECK(stream_eval(expr, sys, input, output_file.m_path, "score", chunk_rows) == rows);
+            const auto [name, values] = result();
+            CHECK(name == "score");
+            CHECK(values == expected);
+        }
+    }
+    SUBCASE("Every chunk starts from the input and initial values")
+    {
+        // b would keep growing across chunks if assignments leaked from one chunk into the next
+        const auto expected = batch_eval(b += a, batch);
+        (void) stream_eval(b += a, sys, input, output_file.m_path, "result", 999);
+        CHECK(result().second == expected);
+    }
+    SUBCASE("Division by zero")
+    {
+        CHECK_THROWS_MESSAGE(stream_eval(a / (c - 1), sys, input, output_file.m_path), "division by zero");
+        bool error = false;
+        (void) stream_eval(a / (c - 1), sys, input, output_file.m_path, "result", 1000, simd_kernels(),
+                           sticky_error_t{error});
+        CHECK(error);
+    }
+}
@@ -0,0 +1,132 @@
+#include "cse.hpp"
+
+#include <doctest/doctest.h>
+
+#include <string>
+
+TEST_CASE("Common subexpression elimination")
+{
+    auto sys = symbol_table_t{};
+    auto a = sys.variable("a", 2);
+    auto b = sys.variable("b", 3);
+    auto c = sys.variable("c", 5);
+
+    auto &state = sys.m_state;
+    ast_evaluator_t evaluator;
+
+    SUBCASE("Structural equality of expression templates")
+    {
+        static_assert(structurally_equal(variable_t{0} + 1.0, variable_t{0} + 1.0));
+        static_assert(!structurally_equal(variable_t{0} + 1.0, variable_t{0} + 2.0));
+        static_assert(!structurally_equal(variable_t{0} + 1.0, variable_t{0} - 1.0));
+        static_assert(!structurally_equal(variable_t{0} + 1.0, 1.0 + variable_t{0}));
+        CHECK(structurally_equal((a + b) * -c, (a + b) * -c));
+        CHECK_FALSE(structurally_equal((a + b) * -c, (a + c) * -c));
+        CHECK(structurally_equal(c += a, c += a));
+        CHECK_FALSE(structurally_equal(c += a, b += a));
+        static_assert(structurally_equal(static_variable_t<1>{} * 2.0, static_variable_t<1>{} * 2.0));
+        static_assert(!structurally_equal(static_variable_t<1>{} * 2.0, static_variable_t<2>{} * 2.0));
+    }
+    SUBCASE("Static variables lower like runtime ones")
+    {
+        const auto x = static_variable_t<0>{};
+        const auto z = static_variable_t<2>{};
+        const auto ast = eliminate_common_subexpressions(x * z + x * z);
+        CHECK(ast.size() == 4);
+        CHECK(evaluator.run(ast, state) == 20);
+        CHECK(run(compile(z += x), state) == 7);
+    }
+    SUBCASE("Repeated subtrees are evaluated once")
+    {
+        const auto expr = (a + b) * (a + b) + (a + b);
+        cse_pass_t pass;
+        const auto dag = pass.run(to_ast(expr));
+        CHECK(pass.m_stats.m_nodes_before == 11);
+        CHECK(pass.m_stats.m_nodes_after == 5);
+        CHECK(pass.m_stats.deduplicated() == 6);
+
+        auto expected = state;
+        CHECK(evaluator.run(dag, state) == expr(expected));
+        CHECK(dag(state) == expr(expected));
+        CHECK(run(compile(dag), state) == expr(expected));
+        CHECK(compile(dag).m_code.size() < compile(expr).m_code.size());
+    }
+    SUBCASE("Equal constants are shared")
+    {
+        const auto dag = eliminate_common_subexpressions(a * 2 + b * 2 + c * 2);
+        CHECK(dag.m_constants.size() == 1);
+    }
+    SUBCASE("Reads around an assignment are kept apart")
+    {
+        const auto expr = (a + b) * ((a <<= c + 1) + (a + b)) + (c + 1);
+        const auto dag = eliminate_common_subexpressions(expr);
+        // `c + 1` and the second read of b are shared; the two `a + b` see different values of a
+        CHECK(dag.size() == to_ast(expr).size() - 4);
+
+        const auto initial = state;
+        auto expected = initial;
+        CHECK(evaluator.run(dag, state) == expr(expected));
+        CHECK(state == expected);
+        auto compiled = initial;
+        CHECK(run(compile(dag), compiled) == expr(expected = initial));
+        CHECK(compiled == expected);
+    }
+    SUBCASE("Assignments are never merged")
+    {
+        auto ast = parse_ast("c += (c += a) * (c += a)", sys);
+        const auto dag = eliminate_common_subexpressions(ast);
+        // only the read of a is shared
+        CHECK(dag.size() == ast.size() - 1);
+        auto expected = state;
+        CHECK(evaluator.run(dag, state) == ast(expected));
+        CHECK(state == expected);
+    }
+    SUBCASE("Deep sharing from parsed formulas")
+    {
+        auto ast = parse_ast("(a*b+c)*(a*b+c) - (a*b+c)/(a*b+c+1)", sys);
+        cse_pass_t pass;
+        const auto dag = pass.run(ast);
+        CHECK(pass.m_stats.deduplicated() == 15);
+        auto expected = state;
+        CHECK(evaluator.run(dag, state) == doctest::Approx(ast(expected)));
+        CHECK(run(compile(dag), state) == doctest::Approx(ast(expected)));
+    }
+    SUBCASE("Every evaluator agrees when a divisor assigns")
+    {
+        const auto expr = (b + a) / (a <<= 4) + a;
+        auto expected = state;
+        const auto value = expr(expected);
+        // left to right: (3 + 2) / 4 + 4
+        CHECK(value == 5.25);
+        for (const auto &ast: {to_ast(expr), parse_ast("(b + a) / (a <<= 4) + a", sys)}) {
+            const auto dag = eliminate_common_subexpressions(ast);
+            for (const auto &form: {ast, dag}) {
+                auto walked = sys.m_state;
+                auto swept = sys.m_state;
+                auto compiled = sys.m_state;
+                CHECK(form(walked) == value);
+                CHECK(evaluator.run(form, swept) == value);
+                CHECK(run(compile(form), compiled) == value);
+                CHECK(walked == expected);
+                CHECK(swept == expected);
+                CHECK(compiled == expected);
+            }
+        }
+    }
+    SUBCASE("Long chains are rebuilt without recursion")
+    {
+        std::string text = "a";
+        for (int i = 1; i < 100'000; ++i) {
+            text += i % 1000 == 0 ? "+(a+=b)" : "+a*b";
+        }
+        const auto ast = parse_ast(text, sys);
+        cse_pass_t pass;
+        const auto dag = pass.run(ast);
+        // a and a*b are shared until the next of the 99 assignments to a: b, then a read and a product per
+        // stretch, the assignments and the sums
+        CHECK(dag.size() == 1 + 100 * 2 + 99 + 99'999);
+        auto expected = state;
+        CHECK(evaluator.run(dag, state) == evaluator.run(ast, expected));
+        CHECK(state == expected);
+    }
+}
@@ -0,0 +1,113 @@
+#include "csv.hpp"
+
+#include <doctest/doctest.h>
+
+#include <charconv>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <string>
+
+TEST_CASE("CSV ingestion")
+{
+    auto sys = symbol_table_t{};
+    auto a = sys.variable("a", 2);
+    auto b = sys.variable("b", 3);
+    auto c = sys.variable("c", 5);
+
+    SUBCASE("Header names select variables")
+    {
+        // "c" is not in the file and "skipped" is not a variable
+        auto batch = parse_csv("b,skipped,a\n1,x,2\n-3.5, anything ,1e3\n+4,,0.25\n", sys);
+        REQUIRE(batch.rows() == 3);
+        CHECK(std::ranges::equal(batch.column(a), std::vector{2.0, 1000.0, 0.25}));
+        CHECK(std::ranges::equal(batch.column(b), std::vector{1.0, -3.5, 4.0}));
+        CHECK(std::ranges::equal(batch.column(c), std::vector{5.0, 5.0, 5.0}));
+        CHECK(batch_eval(a * b + c, batch) == std::vector{7.0, -3495.0, 6.0});
+    }
+    SUBCASE("Line endings, spaces and delimiters")
+    {
+        const auto batch = parse_csv(" a ; c \r\n 1 ; 2 \r\n3;4", sys, ';');
+        REQUIRE(batch.rows() == 2);
+        CHECK(std::ranges::equal(batch.column(a), std::vector{1.0, 3.0}));
+        CHECK(std::ranges::equal(batch.column(c), std::vector{2.0, 4.0}));
+        CHECK(parse_csv("a\n", sys).rows() == 0);
+        CHECK(parse_csv("a\n1\n\n\n", sys).rows() == 1);
+    }
+    SUBCASE("Numbers outside the double range")
+    {
+        const auto batch = parse_csv("a,b\n1e999,1e-400\n", sys);
+        CHECK(batch.column(a)[0] == std::numeric_limits<double>::infinity());
+        CHECK(batch.column(b)[0] == 0);
+
+        const auto signs = parse_csv("a,b,c\n-1e999,-1e-400,+1e+999\n0.0001e-321,-123e310,1000e-327\n", sys);
+        CHECK(signs.column(a)[0] == -std::numeric_limits<double>::infinity());
+        CHECK(signs.column(b)[0] == 0);
+        CHECK(std::signbit(signs.column(b)[0]));
+        CHECK(signs.column(c)[0] == std::numeric_limits<double>::infinity());
+        CHECK(signs.column(a)[1] == 0);
+        CHECK(signs.column(b)[1] == -std::numeric_limits<double>::infinity());
+        CHECK(signs.column(c)[1] == 0);
+        CHECK_FALSE(std::signbit(signs.column(c)[1]));
+    }
+    SUBCASE("Malformed input")
+    {
+        CHECK_THROWS_AS((void) parse_csv("", sys), parse_error);
+        CHECK_THROWS_MESSAGE((void) parse_csv("a,b\n1,2\n3\n", sys), "too few fields at offset 9");
+        CHECK_THROWS_MESSAGE((void) parse_csv("a,b\n1,2,3\n", sys), "too many fields at offset 7");
+        CHECK_THROWS_MESSAGE((void) parse_csv("a,b\n1,x\n", sys), "expected a number at offset 6");
+        CHECK_THROWS_MESSAGE((void) parse_csv("a,b\n1,\n", sys), "expected a number at offset 6");
+        CHECK_THROWS_MESSAGE((void) parse_csv("a,b\n1,+-5\n", sys), "expected a number at offset 6");
+        CHECK_THROWS_MESSAGE((void) parse_csv("a,b\n1,++5\n", sys), "expected a number at offset 6");
+        CHECK_THROWS_MESSAGE((void) parse_csv("a,b,a\n1,2,3\n", sys), "duplicate column 'a' at offset 4");
+    }
+    SUBCASE("Files are read through a mapping")
+    {
+        const auto path = std::filesystem::temp_directory_path() / "dsl2_test.csv";
+        std::ofstream{path} << "c,a\n1.5,2.5\n";
+        const auto batch = read_csv(path, sys);
+        std::filesystem::remove(path);
+        CHECK(batch.column(c)[0] == 1.5);
+        CHECK(batch.column(a)[0] == 2.5);
+        CHECK_THROWS_AS((void) read_csv("/nonexistent/file.csv", sys), std::runtime_error);
+    }
+}
+
+TEST_CASE("CSV values round trip exactly")
+{
+    auto sys = symbol_table_t{};
+    std::string text;
+    for (std::size_t id = 0; id < 6; ++id) {
+        // long names so that the header scan crosses 16-byte blocks
+        (void) sys.variable("a_rather_long_column_name_" + std::to_string(id), 0);
+        text += (id == 0 ? "" : ",") + std::string{sys.name(id)};
+    }
+    text += ",ignored_column_with_a_long_name\n";
+
+    std::mt19937_64 random{23};
+    std::uniform_real_distribution<double> distribution{-1e6, 1e6};
+    constexpr std::size_t rows = 2000;
+    std::vector<std::vector<double>> expected(6, std::vector<double>(rows));
+    for (std::size_t row = 0; row < rows; ++row) {
+        for (std::size_t id = 0; id < 6; ++id) {
+            auto value = distribution(random);
+            if (id == 5) {
+                value = std::ldexp(value, static_cast<int>(random() % 600) - 300);
+            }
+            expected[id][row] = value;
+            char buffer[32];
+            const auto written = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+            text += std::string_view{buffer, static_cast<std::size_t>(written - buffer)};
+            text += ',';
+        }
+        text += "some text that is skipped over\n";
+    }
+
+    const auto batch = parse_csv(text, sys);
+    REQUIRE(batch.rows() == rows);
+    for (std::size_t id = 0; id < 6; ++id) {
+        CHECK(std::ranges::equal(batch.column(id), expected[id]));
+    }
+}
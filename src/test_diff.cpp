@@ -0,0 +1,70 @@
+#include "diff.hpp"
+
+#include <doctest/doctest.h>
+
+TEST_CASE("Forward-mode differentiation")
+{
+    auto sys = symbol_table_t{};
+    auto a = sys.variable("a", 2);
+    auto b = sys.variable("b", 3);
+    auto c = sys.variable("c", 0);
+
+    auto &state = sys.m_state;
+
+    SUBCASE("Elementary rules")
+    {
+        CHECK(differentiate(a, state, a).derivative() == 1);
+        CHECK(differentiate(a, state, b).derivative() == 0);
+        CHECK(differentiate(constant_t(4.0) + b, state, a).derivative() == 0);
+        CHECK(differentiate(-a, state, a).derivative() == -1);
+        CHECK(differentiate(a + b, state, a).derivative() == 1);
+        CHECK(differentiate(a - b, state, b).derivative() == -1);
+        CHECK(differentiate(a * b, state, a).derivative() == 3);
+        CHECK(differentiate(a * a, state, a).derivative() == 4);
+        CHECK(differentiate(a / b, state, b) == dual_t<1>{2. / 3, {-2. / 9}});
+    }
+    SUBCASE("Gradient of every variable in one pass")
+    {
+        // f = (a + b) * c' - a / b with c' = c + a*a
+        const auto f = (a + b) * (c + a * a) - a / b;
+        const auto result = differentiate(f, state, std::array{a, b, c});
+        auto copy = state;
+        CHECK(result.m_value == f(copy));
+        CHECK(result.derivative(0) == doctest::Approx((c(state) + 4) + 5 * 4 - 1. / 3));
+        CHECK(result.derivative(1) == doctest::Approx(c(state) + 4 + 2. / 9));
+        CHECK(result.derivative(2) == doctest::Approx(5));
+    }
+    SUBCASE("Agrees with finite differences")
+    {
+        const auto f = (a * b - 1.5) / (b + a * a) * (a - b * b);
+        const auto result = differentiate(f, state, std::array{a, b});
+        constexpr double h = 1e-6;
+        for (const auto &[i, variable]: {std::pair{0, a}, std::pair{1, b}}) {
+            auto up = state;
+            auto down = state;
+            up[variable.m_id] += h;
+            down[variable.m_id] -= h;
+            CHECK(result.derivative(i) == doctest::Approx((f(up) - f(down)) / (2 * h)).epsilon(1e-6));
+        }
+    }
+    SUBCASE("Assignments carry derivatives through the state")
+    {
+        auto tangents = seed_tangents(state, std::array{a});
+        diff_visitor_t<1> visitor{state, tangents};
+        CHECK(visitor.visit(c <<= a * a).derivative() == 4);
+        CHECK(visitor.visit(c *= a).derivative() == 12);
+        CHECK(visitor.visit(c / b).derivative() == 4);
+        CHECK(c(state) == 8);
+    }
+    SUBCASE("Operands are evaluated left to right, as by eval_visitor_t")
+    {
+        auto copy = state;
+        const auto f = a / (a <<= b * b);
+        CHECK(differentiate(f, state, b) == dual_t<1>{f(copy), {-2. * 6 / 81}});
+        CHECK(a(state) == 9);
+    }
+    SUBCASE("Division by zero")
+    {
+        CHECK_THROWS_MESSAGE((void) differentiate(a / c, state, a), "division by zero");
+    }
+}
@@ -0,0 +1,88 @@
+#include "gradient.hpp"
+#include "diff.hpp"
+
+#include <doctest/doctest.h>
+
+#include <string>
+
+TEST_CASE("Reverse-mode differentiation")
+{
+    auto sys = symbol_table_t{};
+    auto a = sys.variable("a", 2);
+    auto b = sys.variable("b", 3);
+    auto c = sys.variable("c", 0);
+
+    auto &state = sys.m_state;
+    std::vector<double> gradient;
+
+    SUBCASE("Matches forward mode")
+    {
+        const auto f = (a * b - 1.5) / (b + a * a) * (a - b * b) + -c * a;
+        auto forward_state = state;
+        const auto forward = differentiate(f, forward_state, std::array{a, b, c});
+        CHECK(evaluate_gradient(f, state, gradient) == forward.m_value);
+        REQUIRE(gradient.size() == 3);
+        for (std::size_t i = 0; i < 3; ++i) {
+            CHECK(gradient[i] == doctest::Approx(forward.derivative(i)));
+        }
+    }
+    SUBCASE("Constants and untouched variables")
+    {
+        CHECK(evaluate_gradient(constant_t(4.0) * constant_t(2.0) + b, state, gradient) == 11);
+        CHECK(gradient == std::vector<double>{0, 1, 0});
+        CHECK(evaluate_gradient(+a, state, gradient) == 2);
+        CHECK(gradient == std::vector<double>{1, 0, 0});
+    }
+    SUBCASE("Assignments are followed through the state")
+    {
+        // c = a*a; c *= a  =>  c = a^3
+        CHECK(evaluate_gradient((c <<= a * a) * 0 + (c *= a) + c / b, state, gradient) == doctest::Approx(8 + 8. / 3));
+        CHECK(gradient[0] == doctest::Approx(12 + 12. / 3));
+        CHECK(gradient[1] == doctest::Approx(-8. / 9));
+        CHECK(gradient[2] == 0);
+        CHECK(c(state) == 8);
+    }
+    SUBCASE("Operands are evaluated left to right, as by eval_visitor_t")
+    {
+        CHECK(evaluate_gradient(a / (a <<= b * b), state, gradient) == doctest::Approx(2. / 9));
+        CHECK(gradient[0] == doctest::Approx(1. / 9));
+        CHECK(gradient[1] == doctest::Approx(-2. * 6 / 81));
+        CHECK(a(state) == 9);
+    }
+    SUBCASE("Runtime expressions")
+    {
+        const auto text = std::string{"(a*b-1.5)/(b+a*a)*(a-b*b)+-c*a"};
+        const auto f = (a * b - 1.5) / (b + a * a) * (a - b * b) + -c * a;
+        std::vector<double> expected;
+        auto copy = state;
+        const auto value = evaluate_gradient(f, copy, expected);
+
+        gradient_tape_t tape;
+        CHECK(tape.run(parse_ast(text, sys), state, gradient) == value);
+        REQUIRE(gradient.size() == expected.size());
+        for (std::size_t i = 0; i < expected.size(); ++i) {
+            CHECK(gradient[i] == doctest::Approx(expected[i]));
+        }
+    }
+    SUBCASE("The tape is reused")
+    {
+        const auto ast = parse_ast("a*b*c+a/b-c*c*a", sys);
+        gradient_tape_t tape;
+        (void) tape.run(ast, state, gradient);
+        const auto *const entries = tape.m_entries.data();
+        const auto *const adjoints = tape.m_adjoints.data();
+        const auto *const result = gradient.data();
+        for (int i = 0; i < 10; ++i) {
+            (void) tape.run(ast, state, gradient);
+        }
+        CHECK(tape.m_entries.data() == entries);
+        CHECK(tape.m_adjoints.data() == adjoints);
+        CHECK(gradient.data() == result);
+    }
+    SUBCASE("Division by zero")
+    {
+        CHECK_THROWS_MESSAGE((void) evaluate_gradient(a / c, state, gradient), "division by zero");
+        gradient_tape_t tape;
+        CHECK_THROWS_MESSAGE((void) tape.run(parse_ast("a/c", sys), state, gradient), "division by zero");
+    }
+}
@@ -0,0 +1,82 @@
+#include "incremental.hpp"
+#include "cse.hpp"
+
+#include <doctest/doctest.h>
+
+TEST_CASE("Incremental evaluation")
+{
+    auto sys = symbol_table_t{};
+    auto a = sys.variable("a", 2);
+    auto b = sys.variable("b", 3);
+    auto c = sys.variable("c", 5);
+
+    incremental_engine_t engine{sys};
+    const auto ab = engine.add((a + b) * (a - 1.0));
+    const auto bc = engine.add(b / c + -c);
+
+    SUBCASE("First evaluation computes everything")
+    {
+        CHECK(engine.value(ab) == 5);
+        CHECK(engine.value(bc) == 3. / 5 - 5);
+        CHECK(engine.m_evaluated == 7 + 6);
+    }
+    SUBCASE("Only expressions reading a changed variable are recomputed")
+    {
+        (void) engine.value(ab);
+        (void) engine.value(bc);
+        engine.m_evaluated = 0;
+
+        engine.set(c, 10);
+        CHECK_FALSE(engine.dirty(ab));
+        CHECK(engine.dirty(bc));
+        CHECK(engine.value(ab) == 5);
+        CHECK(engine.m_evaluated == 0);
+        CHECK(engine.value(bc) == 3. / 10 - 10);
+        // both reads of c, b/c, -c and the sum; only the read of b stays cached
+        CHECK(engine.m_evaluated == 5);
+    }
+    SUBCASE("Only the changed path within an expression is recomputed")
+    {
+        (void) engine.value(ab);
+        engine.m_evaluated = 0;
+        engine.set(b, 4);
+        CHECK(engine.value(ab) == 6);
+        // b, a+b and the product; a, 1 and a-1 stay cached
+        CHECK(engine.m_evaluated == 3);
+    }
+    SUBCASE("Setting the same value changes nothing")
+    {
+        (void) engine.value(ab);
+        engine.set(a, 2);
+        CHECK_FALSE(engine.dirty(ab));
+        CHECK(engine.get(a) == 2);
+    }
+    SUBCASE("Shared subexpressions")
+    {
+        const auto shared = engine.add(eliminate_common_subexpressions((a * b) * (a * b) - a * b));
+        CHECK(engine.value(shared) == 30);
+        engine.set(a, 1);
+        CHECK(engine.value(shared) == 6);
+        engine.set(b, 2);
+        CHECK(engine.value(shared) == 2);
+    }
+    SUBCASE("Runtime expressions")
+    {
+        const auto parsed = engine.add(parse_ast("a*a+b*c", sys));
+        CHECK(engine.value(parsed) == 19);
+        engine.set(a, -1);
+        CHECK(engine.value(parsed) == 16);
+    }
+    SUBCASE("Errors")
+    {
+        CHECK_THROWS_AS(engine.add(c += a), std::invalid_argument);
+        CHECK_THROWS_AS(engine.add(variable_t{7} + a), std::out_of_range);
+
+        engine.set(c, 0);
+        CHECK_THROWS_MESSAGE((void) engine.value(bc), "division by zero");
+        engine.set(c, 1);
+        CHECK(engine.value(bc) == 2);
+        // rejected expressions leave no trace
+        CHECK(engine.value(ab) == 5);
+    }
+}
@@ -0,0 +1,158 @@
+#include "jit.hpp"
+#include "ast.hpp"
+
+#include <doctest/doctest.h>
+
+#include <bit>
+#include <random>
+#include <string>
+
+TEST_CASE("Native code")
+{
+    auto sys = symbol_table_t{};
+    auto a = sys.variable("a", 2);
+    auto b = sys.variable("b", 3);
+    auto c = sys.variable("c", 0);
+
+    auto &state = sys.m_state;
+    vm_t vm;
+
+    // runs `expr` through the JIT and through the VM on a copy of the state; both must agree on value and state
+    const auto same_as_vm = [&](const auto &expr) {
+        jit_program_t native{expr};
+        auto expected = state;
+        const auto value = native.run(state);
+        return std::bit_cast<std::uint64_t>(value) == std::bit_cast<std::uint64_t>(vm.run(compile(expr), expected)) &&
+               state == expected;
+    };
+
+    SUBCASE("Used wherever the platform allows it")
+    {
+        CHECK(jit_program_t{a + b}.native() == (DSL2_JIT && simd_supported(simd_isa_t::sse2)));
+    }
+    SUBCASE("Evaluation matches the interpreter")
+    {
+        CHECK(same_as_vm(a));
+        CHECK(same_as_vm(constant_t(4.0)));
+        CHECK(same_as_vm(-b));
+        CHECK(same_as_vm(+b));
+        CHECK(same_as_vm(a + b));
+        CHECK(same_as_vm(a - 7));
+        CHECK(same_as_vm(7 * a));
+        CHECK(same_as_vm(a / b));
+        CHECK(same_as_vm(a - (b - (c * (a + b)))));
+        // the sign of zero survives negation
+        CHECK(same_as_vm(-c));
+    }
+    SUBCASE("Assignments")
+    {
+        CHECK(same_as_vm(c <<= b - a));
+        CHECK(same_as_vm(c += b - a * c));
+        CHECK(same_as_vm(c -= a));
+        CHECK(same_as_vm(c *= a));
+        CHECK(same_as_vm(c /= a));
+        CHECK(same_as_vm(a + (a <<= 1)));
+    }
+    SUBCASE("Operands that assign are evaluated as by eval_visitor_t")
+    {
+        const auto agrees = [&](const auto &expr) {
+            auto expected = state;
+            const auto value = expr(expected);
+            return jit_program_t{expr}.run(state) == value && state == expected;
+        };
+        CHECK(agrees(a / (a <<= 4)));
+        CHECK(agrees((a += 1) / (a *= 2) - a));
+        CHECK(agrees((b <<= a) * (a <<= b + 1) + (c -= a / b)));
+
+        auto expected = state;
+        CHECK_THROWS_MESSAGE((void) ((c += 1) / (a - a))(expected), "division by zero");
+        CHECK_THROWS_MESSAGE(jit_program_t{(c += 1) / (a - a)}.run(state), "division by zero");
+        CHECK(state == expected);
+    }
+    SUBCASE("More registers than SSE registers")
+    {
+        // right-nested, so every level holds one more register
+        const auto nested = a + (b - (c * (a + (b - (c * (a + (b - (c * (a + b)))))))));
+        const auto deep = nested - a / (b + (c + (a + (b + (c + (a + (b + (c + (a + nested)))))))));
+        CHECK(compile(deep).m_registers > jit_assembler_t::xmm_registers);
+        CHECK(same_as_vm(deep));
+        CHECK(same_as_vm(c += deep));
+    }
+    SUBCASE("Division by zero stops at the same point as the interpreter")
+    {
+        CHECK_THROWS_MESSAGE(jit_program_t{a / c}.run(state), "division by zero");
+
+        auto expected = state;
+        jit_program_t native{(b <<= 5) + a / c + (a <<= 1)};
+        CHECK_THROWS_MESSAGE(native.run(state), "division by zero");
+        CHECK_THROWS_MESSAGE(vm.run(native.program(), expected), "division by zero");
+        CHECK(state == expected);
+        CHECK(state[b.m_id] == 5);
+        CHECK(state[a.m_id] == 2);
+    }
+    SUBCASE("The state must cover every variable")
+    {
+        state_t small{1.0};
+        CHECK_THROWS_AS(jit_program_t{a + c}.run(small), std::out_of_range);
+    }
+    SUBCASE("Moving keeps the code")
+    {
+        jit_program_t first{a * b};
+        jit_program_t second{std::move(first)};
+        CHECK(second.run(state) == 6);
+        first = std::move(second);
+        CHECK(first.run(state) == 6);
+    }
+}
+
+TEST_CASE("Native code for random programs")
+{
+    auto sys = symbol_table_t{};
+    for (char name = 'a'; name <= 'h'; ++name) {
+        (void) sys.variable(std::string{name}, static_cast<double>(name - 'a') + 0.25);
+    }
+
+    std::mt19937 random{20};
+    const auto pick = [&](std::size_t n) { return std::uniform_int_distribution<std::size_t>{0, n - 1}(random); };
+    const auto name = [&sys](const std::size_t id) { return std::string{sys.name(id)}; };
+    // a random expression of up to `depth` levels, sometimes assigning
+    const auto generate = [&](auto &self, const int depth) -> std::string {
+        if (depth == 0 || pick(4) == 0) {
+            return pick(3) == 0 ? std::to_string(pick(9) + 1) : name(pick(8));
+        }
+        switch (pick(7)) {
+            case 0:
+                return "-(" + self(self, depth - 1) + ")";
+            case 1:
+                return "(" + name(pick(8)) + (pick(2) == 0 ? "+=" : "*=") + self(self, depth - 1) + ")";
+            default:
+                constexpr const char *operators[] = {"+", "-", "*", "/"};
+                return "(" + self(self, depth - 1) + operators[pick(4)] + self(self, depth - 1) + ")";
+        }
+    };
+
+    vm_t vm;
+    for (int round = 0; round < 200; ++round) {
+        const auto program = compile(parse_ast(generate(generate, 8), sys));
+        auto state = sys.m_state;
+        auto expected = state;
+        jit_program_t native{program};
+        double value = 0;
+        double expected_value = 0;
+        bool failed = false;
+        bool expected_failed = false;
+        try {
+            value = native.run(state);
+        } catch (const std::logic_error &) {
+            failed = true;
+        }
+        try {
+            expected_value = vm.run(program, expected);
+        } catch (const std::logic_error &) {
+            expected_failed = true;
+        }
+        CHECK(failed == expected_failed);
+        CHECK(std::bit_cast<std::uint64_t>(value) == std::bit_cast<std::uint64_t>(expected_value));
+        CHECK(state == expected);
+    }
+}
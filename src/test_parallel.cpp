@@ -0,0 +1,168 @@
+#include "parallel.hpp"
+#include "schedule.hpp"
+
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <random>
+#include <string>
+
+TEST_CASE("Thread pool")
+{
+    thread_pool_t pool{4};
+
+    SUBCASE("Every index runs exactly once")
+    {
+        std::vector<std::atomic<int>> runs(1000);
+        pool.parallel_for(runs.size(), [&](const std::size_t i) { ++runs[i]; });
+        CHECK(std::ranges::all_of(runs, [](const auto &count) { return count == 1; }));
+    }
+    SUBCASE("Nested loops do not deadlock")
+    {
+        std::atomic<int> total = 0;
+        pool.parallel_for(16, [&](std::size_t) {
+            pool.parallel_for(16, [&](std::size_t) { ++total; });
+        });
+        CHECK(total == 256);
+    }
+    SUBCASE("Exceptions reach the caller")
+    {
+        CHECK_THROWS_MESSAGE(pool.parallel_for(8, [](const std::size_t i) {
+            if (i == 5) {
+                throw std::runtime_error{"task failed"};
+            }
+        }), "task failed");
+        // the pool is still usable afterwards
+        std::atomic<int> total = 0;
+        pool.parallel_for(8, [&](std::size_t) { ++total; });
+        CHECK(total == 8);
+    }
+    SUBCASE("Without workers everything runs inline")
+    {
+        thread_pool_t inline_pool{0};
+        int total = 0;
+        inline_pool.parallel_for(10, [&](std::size_t) { ++total; });
+        CHECK(total == 10);
+    }
+}
+
+// A balanced tree with 2^Depth leaves cycling through the given variables.
+template<std::size_t Depth, std::size_t Index = 0>
+static constexpr auto balanced_tree(const variable_t &a, const variable_t &b, const variable_t &c) {
+    if constexpr (Depth == 0) {
+        return Index % 3 == 0 ? a : Index % 3 == 1 ? b : c;
+    } else if constexpr (Depth % 2 == 0) {
+        return balanced_tree<Depth - 1, 2 * Index>(a, b, c) + balanced_tree<Depth - 1, 2 * Index + 1>(a, b, c);
+    } else {
+        return balanced_tree<Depth - 1, 2 * Index>(a, b, c) * balanced_tree<Depth - 1, 2 * Index + 1>(a, b, c);
+    }
+}
+
+TEST_CASE("Parallel evaluation")
+{
+    auto sys = symbol_table_t{};
+    auto a = sys.variable("a", 0.5);
+    auto b = sys.variable("b", 1.25);
+    auto c = sys.variable("c", 2);
+    auto &state = sys.m_state;
+    thread_pool_t pool{3};
+
+    SUBCASE("Large operands are split and give the same result")
+    {
+        const auto tree = balanced_tree<8>(a, b, c);
+        static_assert(node_count_v<std::remove_cvref_t<decltype(tree)>> == 511);
+        auto copy = state;
+        CHECK(parallel_eval(tree, state, pool, 16) == tree(copy));
+        CHECK(parallel_eval(-(tree * (tree - c)), state, pool, 16) == (-(tree * (tree - c)))(copy));
+    }
+    SUBCASE("Errors and assignments")
+    {
+        const auto tree = balanced_tree<6>(a, b, c);
+        CHECK_THROWS_MESSAGE((void) parallel_eval(tree / (tree - tree), state, pool, 8), "division by zero");
+        // operands that write the state are evaluated in order on the calling thread
+        auto copy = state;
+        CHECK(parallel_eval(tree + (c <<= tree), state, pool, 8) == (tree + (c <<= tree))(copy));
+        CHECK(state == copy);
+    }
+}
+
+TEST_CASE("Parallel statement scheduling")
+{
+    auto sys = symbol_table_t{};
+    for (char name = 'a'; name <= 'p'; ++name) {
+        (void) sys.variable(std::string{name}, static_cast<double>(name - 'a') / 8);
+    }
+    thread_pool_t pool{4};
+
+    std::mt19937 random{9};
+    const auto pick = [&](std::size_t n) { return std::uniform_int_distribution<std::size_t>{0, n - 1}(random); };
+    const auto name = [&sys](const std::size_t id) { return std::string{sys.name(id)}; };
+    constexpr const char *assignments[] = {"<<=", "+=", "-=", "*="};
+    for (int round = 0; round < 20; ++round) {
+        std::vector<ast_t> statements;
+        for (int i = 0; i < 40; ++i) {
+            std::string text = name(pick(16)) + assignments[pick(4)] + name(pick(16)) + "*0.5+" + name(pick(16)) + "-" +
+                               name(pick(16));
+            statements.push_back(parse_ast(text, sys));
+        }
+        auto program = schedule(statements);
+        // every wave with two or more statements goes to the pool
+        program.m_min_parallel_nodes = 0;
+
+        auto expected = sys.m_state;
+        const auto expected_value = program.run(expected);
+        auto state = sys.m_state;
+        CHECK(program.run(state, pool) == expected_value);
+        CHECK(state == expected);
+    }
+}
+
+TEST_CASE("Parallel batch evaluation")
+{
+    auto sys = symbol_table_t{};
+    auto a = sys.variable("a", 2);
+    auto b = sys.variable("b", 3);
+    auto c = sys.variable("c", 1);
+    thread_pool_t pool{3};
+
+    // not a multiple of the chunk or block size, so the last chunk is short
+    constexpr std::size_t rows = 10'000;
+    auto batch = make_batch(sys, rows, pool, 1024);
+    CHECK(batch.m_data == batch_t{sys, rows}.m_data);
+    for (std::size_t i = 0; i < rows; ++i) {
+        batch.column(a)[i] = static_cast<double>(i);
+        batch.column(c)[i] = static_cast<double>(i % 5) + 1;
+    }
+
+    SUBCASE("Results match single-threaded evaluation for any chunk size")
+    {
+        const auto expected = batch_eval(a - b / c * (a + 1), batch);
+        for (const std::size_t chunk_rows: {std::size_t{0}, std::size_t{256}, std::size_t{1000}, rows}) {
+            CHECK(parallel_batch_eval(a - b / c * (a + 1), batch, pool, chunk_rows) == expected);
+        }
+    }
+    SUBCASE("Assignments write every row")
+    {
+        auto copy = batch;
+        const auto expected = batch_eval(c += b - a * c, copy);
+        CHECK(parallel_batch_eval(c += b - a * c, batch, pool, 512) == expected);
+        CHECK(batch.m_data == copy.m_data);
+    }
+    SUBCASE("Division by zero in one chunk")
+    {
+        batch.column(c)[rows - 1] = 0;
+        CHECK_THROWS_MESSAGE((void) parallel_batch_eval(a / c, batch, pool, 512), "division by zero");
+
+        bool error = false;
+        (void) parallel_batch_eval(a / (c - 1), batch, pool, 512, simd_kernels(), sticky_error_t{error});
+        CHECK(error);
+        error = false;
+        (void) parallel_batch_eval(a / (c + 1), batch, pool, 512, simd_kernels(), sticky_error_t{error});
+        CHECK_FALSE(error);
+    }
+    SUBCASE("Chunks fill the cache budget in whole blocks")
+    {
+        CHECK(batch_chunk_rows(3, 256 * 1024) == 8192);
+        CHECK(batch_chunk_rows(1000, 256 * 1024) == batch_eval_visitor_t<>::block_size);
+    }
+}
@@ -0,0 +1,85 @@
+#include "parser.hpp"
+
+#include <doctest/doctest.h>
+
+#include <sstream>
+
+TEST_CASE("Parser")
+{
+    auto sys = symbol_table_t{};
+    auto a = sys.variable("a", 2);
+    auto b = sys.variable("b", 3);
+    auto c = sys.variable("c", 0);
+
+    auto &state = sys.m_state;
+
+    const auto eval = [&](std::string_view text) {
+        return run(parse_program(text, sys), state);
+    };
+
+    SUBCASE("Variables and constants")
+    {
+        CHECK(eval("a") == 2);
+        CHECK(eval("  b ") == 3);
+        CHECK(eval("4.5") == 4.5);
+        CHECK(eval("1e3") == 1000);
+    }
+    SUBCASE("Precedence and associativity")
+    {
+        CHECK(eval("a+b*c") == (a + b * c)(state));
+        CHECK(eval("a-b-c") == ((a - b) - c)(state));
+        CHECK(eval("a/b/2") == ((a / b) / 2)(state));
+        CHECK(eval("a-(b-c)") == (a - (b - c))(state));
+        CHECK(eval("-a*-b") == ((-a) * (-b))(state));
+        CHECK(eval("+a") == 2);
+    }
+    SUBCASE("Assignments")
+    {
+        CHECK(eval("c<<=b-a") == 1);
+        CHECK(c(state) == 1);
+        CHECK(eval("c+=b-a*c") == 2);
+        CHECK(eval("c -= 1") == 1);
+        CHECK(eval("c*=4") == 4);
+        CHECK(eval("c/=2") == 2);
+        CHECK(eval("a<<=b<<=5") == 5);
+        CHECK(a(state) == 5);
+    }
+    SUBCASE("Round trip through print_visitor")
+    {
+        const auto check = [&](const auto &expr) {
+            std::stringstream ss;
+            ss << printer{sys, expr};
+            auto expected = state;
+            CHECK(eval(ss.str()) == expr(expected));
+            CHECK(state == expected);
+        };
+        check(a + b);
+        check(a + b * c);
+        check(a * 2 - b / 4);
+        check(c += b - a * c);
+        check(a <<= b);
+        check(a + 2);
+    }
+    SUBCASE("Formula files")
+    {
+        const auto programs = parse_programs("c <<= a + b\n\n  c *= 2; a - c\r\n", sys);
+        REQUIRE(programs.size() == 3);
+        CHECK(run(programs[0], state) == 5);
+        CHECK(run(programs[1], state) == 10);
+        CHECK(run(programs[2], state) == -8);
+    }
+    SUBCASE("Errors")
+    {
+        CHECK_THROWS_AS((void) parse_program("", sys), parse_error);
+        CHECK_THROWS_MESSAGE((void) parse_program("a + d", sys), "unknown variable 'd' at offset 4");
+        CHECK_THROWS_MESSAGE((void) parse_program("zz <<= 1", sys), "unknown variable 'zz' at offset 0");
+        CHECK_THROWS_MESSAGE((void) parse_program("a + (zz += 1)", sys), "unknown variable 'zz' at offset 5");
+        CHECK_THROWS_MESSAGE((void) parse_program("a +", sys), "unexpected end of input at offset 3");
+        CHECK_THROWS_MESSAGE((void) parse_program("(a + b", sys), "expected ')' at offset 6");
+        CHECK_THROWS_MESSAGE((void) parse_program("a b", sys), "unexpected character at offset 2");
+        CHECK_THROWS_MESSAGE((void) parse_program("a - b += c", sys), "assignment to an expression at offset 6");
+        CHECK_THROWS_MESSAGE((void) parse_program("a; b", sys), "more than one statement at offset 3");
+        CHECK_THROWS_AS((void) parse_program(std::string(100000, '(') + "a", sys), parse_error);
+        CHECK_THROWS_AS((void) parse_program(std::string(100000, '-') + "a", sys), parse_error);
+    }
+}
@@ -0,0 +1,84 @@
+#include "schedule.hpp"
+
+#include <doctest/doctest.h>
+
+#include <random>
+#include <string>
+
+TEST_CASE("Statement scheduling")
+{
+    auto sys = symbol_table_t{};
+    auto a = sys.variable("a", 2);
+    auto b = sys.variable("b", 3);
+    auto c = sys.variable("c", 0);
+    auto d = sys.variable("d", 1);
+    auto e = sys.variable("e", 1);
+
+    // runs the statements one by one in the order given
+    const auto sequential = [](const std::vector<ast_t> &statements, state_t &state) {
+        double result = 0;
+        for (const auto &statement: statements) {
+            result = statement(state);
+        }
+        return result;
+    };
+
+    SUBCASE("Dependencies and waves")
+    {
+        auto program = schedule(d <<= (a + b) * c, c <<= 4, e <<= a * b, d += e, a <<= b);
+        // c <<= 4 must follow the read of c, d += e follows both writes of d and e, a <<= b follows the reads of a
+        CHECK(program.m_dependencies[0].empty());
+        CHECK(program.m_dependencies[1] == std::vector<std::uint32_t>{0});
+        CHECK(program.m_dependencies[2].empty());
+        CHECK(program.m_dependencies[3] == std::vector<std::uint32_t>{0, 2});
+        CHECK(program.m_dependencies[4] == std::vector<std::uint32_t>{0, 2});
+        CHECK(program.m_waves == std::vector<std::vector<std::uint32_t>>{{0, 2}, {1, 3, 4}});
+
+        auto state = sys.m_state;
+        auto expected = sys.m_state;
+        CHECK(program.run(state) == sequential(program.m_statements, expected));
+        CHECK(state == expected);
+        CHECK(state == state_t{3, 3, 4, 6, 6});
+    }
+    SUBCASE("Store expression and evaluate lazily, as one program")
+    {
+        auto program = schedule(d <<= (a + b) * c, c <<= 4, e <<= (a + b) * c);
+        auto state = sys.m_state;
+        CHECK(program.run(state) == 20);
+        CHECK(state[d.m_id] == 0);
+        CHECK(program.m_waves.size() == 3);
+    }
+    SUBCASE("The value is that of the last statement given, even if it is independent")
+    {
+        auto program = schedule(c <<= a, d <<= c, e <<= c + d, b * 2);
+        CHECK(program.m_waves.front() == std::vector<std::uint32_t>{0, 3});
+        auto state = sys.m_state;
+        CHECK(program.run(state) == 6);
+        CHECK(state[e.m_id] == 4);
+    }
+    SUBCASE("Random programs behave like running the statements in order")
+    {
+        std::mt19937 random{5};
+        const auto pick = [&](std::size_t n) { return std::uniform_int_distribution<std::size_t>{0, n - 1}(random); };
+        const auto name = [&sys](const std::size_t id) { return std::string{sys.name(id)}; };
+        constexpr const char *assignments[] = {"<<=", "+=", "-=", "*="};
+        for (int round = 0; round < 50; ++round) {
+            std::vector<ast_t> statements;
+            for (int i = 0; i < 20; ++i) {
+                std::string text = name(pick(5)) + assignments[pick(4)] + name(pick(5)) + "*0.5+" + name(pick(5));
+                statements.push_back(parse_ast(text, sys));
+            }
+            auto expected = sys.m_state;
+            const auto expected_value = sequential(statements, expected);
+
+            auto program = schedule(statements);
+            auto state = sys.m_state;
+            CHECK(program.run(state) == expected_value);
+            CHECK(state == expected);
+        }
+    }
+    SUBCASE("An empty program")
+    {
+        CHECK_THROWS_AS((void) schedule(std::vector<ast_t>{}), std::invalid_argument);
+    }
+}
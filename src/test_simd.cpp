@@ -0,0 +1,82 @@
+#include "batch.hpp"
+#include "simd.hpp"
+
+#include <doctest/doctest.h>
+
+#include <vector>
+
+TEST_CASE("SIMD kernels")
+{
+    // odd length so every kernel also runs its scalar tail
+    constexpr std::size_t n = 37;
+    std::vector<double> a(n), b(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        a[i] = static_cast<double>(i) - 10.5;
+        b[i] = static_cast<double>(i % 5) + 0.25;
+    }
+    const auto &reference = simd_kernels(simd_isa_t::scalar);
+
+    for (const auto isa: {simd_isa_t::sse2, simd_isa_t::avx2, simd_isa_t::avx512}) {
+        const auto &kernels = simd_kernels(isa);
+        CHECK((kernels.m_isa == isa || !simd_supported(isa)));
+
+        for (std::size_t op = 0; op < kernels.m_column_column.size(); ++op) {
+            std::vector<double> expected(n), actual(n);
+
+            reference.m_column_column[op](expected.data(), a.data(), b.data(), n);
+            kernels.m_column_column[op](actual.data(), a.data(), b.data(), n);
+            CHECK(actual == expected);
+
+            reference.m_column_scalar[op](expected.data(), a.data(), 3.0, n);
+            kernels.m_column_scalar[op](actual.data(), a.data(), 3.0, n);
+            CHECK(actual == expected);
+
+            reference.m_scalar_column[op](expected.data(), 3.0, b.data(), n);
+            kernels.m_scalar_column[op](actual.data(), 3.0, b.data(), n);
+            CHECK(actual == expected);
+        }
+
+        std::vector<double> expected(n), actual(n);
+        reference.m_negate(expected.data(), a.data(), n);
+        kernels.m_negate(actual.data(), a.data(), n);
+        CHECK(actual == expected);
+
+        CHECK_FALSE(kernels.m_any_zero(b.data(), n));
+        b[n - 1] = 0;
+        CHECK(kernels.m_any_zero(b.data(), n));
+        b[n - 1] = 0.25;
+        b[0] = 0;
+        CHECK(kernels.m_any_zero(b.data(), n));
+        b[0] = 0.25;
+    }
+
+    SUBCASE("The dispatched kernel set is supported by the CPU")
+    {
+        CHECK(simd_supported(simd_kernels().m_isa));
+    }
+    SUBCASE("In-place compound assignment")
+    {
+        auto inout = a;
+        simd_kernels().m_column_column[static_cast<std::size_t>(operation_t::plus)](inout.data(), inout.data(),
+                                                                                    b.data(), n);
+        for (std::size_t i = 0; i < n; ++i) {
+            CHECK(inout[i] == a[i] + b[i]);
+        }
+    }
+    SUBCASE("Batch evaluation agrees across instruction sets")
+    {
+        auto sys = symbol_table_t{};
+        auto x = sys.variable("x", 0);
+        auto y = sys.variable("y", 0);
+        auto batch = batch_t{sys, 1001};
+        for (std::size_t i = 0; i < batch.rows(); ++i) {
+            batch.column(x)[i] = static_cast<double>(i);
+            batch.column(y)[i] = static_cast<double>(i % 3) + 1;
+        }
+        const auto expr = (x + y) * y - x / (2 - -y);
+        const auto expected = batch_eval(expr, batch, simd_kernels(simd_isa_t::scalar));
+        for (const auto isa: {simd_isa_t::sse2, simd_isa_t::avx2, simd_isa_t::avx512}) {
+            CHECK(batch_eval(expr, batch, simd_kernels(isa)) == expected);
+        }
+    }
+}
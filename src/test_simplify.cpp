@@ -0,0 +1,188 @@
+#include "simplify.hpp"
+
+#include <doctest/doctest.h>
+
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+
+// Node count after simplifying an expression template, computed while compiling.
+template<Node T>
+constexpr std::size_t simplified_size(const T &node, const bool fast_math = false) {
+    return simplify(node, {fast_math}).size();
+}
+
+TEST_CASE("Simplification")
+{
+    auto sys = symbol_table_t{};
+    auto a = sys.variable("a", 2);
+    auto b = sys.variable("b", 3);
+    auto c = sys.variable("c", 5);
+
+    auto &state = sys.m_state;
+
+    SUBCASE("Identities on expression templates at compile time")
+    {
+        constexpr auto x = variable_t{0};
+        constexpr auto y = static_variable_t<1>{};
+        static_assert(simplified_size(x * 1.0) == 1);
+        static_assert(simplified_size(1.0 * x) == 1);
+        static_assert(simplified_size(x / 1.0) == 1);
+        static_assert(simplified_size(-(-x)) == 1);
+        static_assert(simplified_size(+x) == 1);
+        static_assert(simplified_size(x + -0.0) == 1);
+        static_assert(simplified_size(x - 0.0) == 1);
+        static_assert(simplified_size(x * -1.0) == 2);
+        static_assert(simplified_size(x - -y) == 3);
+        static_assert(simplified_size(-(-(x * 1.0)) + (y / 1.0)) == 3);
+        // not exact for x = -0, inf or NaN, so only under fast math
+        static_assert(simplified_size(x + 0.0) == 3);
+        static_assert(simplified_size(x + 0.0, true) == 1);
+        static_assert(simplified_size(x - x) == 3);
+        static_assert(simplified_size(x - x, true) == 1);
+        static_assert(simplified_size(0.0 * (x + y)) == 5);
+        static_assert(simplified_size(0.0 * (x + y), true) == 1);
+    }
+    SUBCASE("Node counts before and after")
+    {
+        simplify_pass_t pass;
+        const auto ast = pass.run(to_ast(-(-(a * 1.0)) + (b / 1.0) * 1.0));
+        CHECK(pass.m_stats.m_nodes_before == 11);
+        CHECK(pass.m_stats.m_nodes_after == 3);
+        CHECK(pass.m_stats.removed() == 8);
+        CHECK(pass.m_stats.m_rewrites == 4);
+        CHECK(reachable_nodes(ast) == ast.size());
+        CHECK(ast(state) == 5);
+    }
+    SUBCASE("Strength reductions")
+    {
+        // dividing by a power of two is exactly a multiplication by its reciprocal
+        const auto halved = simplify(a / 4.0);
+        CHECK(halved[halved.m_root].m_operation == operation_t::mul);
+        CHECK(halved.m_constants == std::vector{0.25});
+        // other divisors round differently, so they need fast math
+        CHECK(simplify(a / 3.0)[simplify(a / 3.0).m_root].m_operation == operation_t::div);
+        const auto third = simplify(a / 3.0, {true});
+        CHECK(third[third.m_root].m_operation == operation_t::mul);
+        CHECK(third(state) == doctest::Approx(2.0 / 3));
+        // doubling a variable is an addition
+        const auto doubled = simplify(2.0 * b);
+        CHECK(doubled.size() == 2);
+        CHECK(doubled(state) == 6);
+    }
+    SUBCASE("Effects and errors are kept")
+    {
+        // the operand assigns, so it stays even when multiplied by zero
+        const auto assigning = simplify(0.0 * (c <<= 7), {true});
+        CHECK(assigning(state) == 0);
+        CHECK(state[c.m_id] == 7);
+        // the operand may divide by zero, so it stays too
+        state[c.m_id] = 0;
+        CHECK_THROWS_MESSAGE((void) simplify(0.0 * (a / c), {true})(state), "division by zero");
+        CHECK_THROWS_MESSAGE((void) simplify((a / c) - (a / c), {true})(state), "division by zero");
+        // a constant zero divisor is left for evaluation to report
+        ast_t zero;
+        zero.binary(operation_t::div, zero.constant(1), zero.constant(0));
+        CHECK_THROWS_MESSAGE((void) simplify(zero)(state), "division by zero");
+    }
+}
+
+TEST_CASE("Simplified random expressions compute the same values")
+{
+    auto sys = symbol_table_t{};
+    for (char name = 'a'; name <= 'f'; ++name) {
+        (void) sys.variable(std::string{name}, 0);
+    }
+
+    std::mt19937 random{21};
+    const auto pick = [&](std::size_t n) { return std::uniform_int_distribution<std::size_t>{0, n - 1}(random); };
+    // constants and values that the identities are most likely to get wrong
+    constexpr double constants[] = {0.0, -0.0, 1.0, -1.0, 2.0, 0.5, 4.0, 3.0};
+    constexpr double values[] = {0.0, -0.0, 1.0, -1.0, 2.5, -3.0, 1e308, -1e-310,
+                                 std::numeric_limits<double>::infinity(), std::numeric_limits<double>::quiet_NaN()};
+
+    const auto generate = [&](ast_t &ast, auto &self, const int depth) -> ast_t::index_type {
+        if (depth == 0 || pick(4) == 0) {
+            return pick(2) == 0 ? ast.constant(constants[pick(std::size(constants))]) : ast.variable(pick(6));
+        }
+        switch (pick(8)) {
+            case 0:
+                return ast.unary(operation_t::minus, self(ast, self, depth - 1));
+            case 1:
+                return ast.unary(operation_t::plus, self(ast, self, depth - 1));
+            case 2:
+                return ast.assign(static_cast<operation_t>(pick(5)), pick(6), self(ast, self, depth - 1));
+            default: {
+                const auto first = self(ast, self, depth - 1);
+                return ast.binary(static_cast<operation_t>(1 + pick(4)), first, self(ast, self, depth - 1));
+            }
+        }
+    };
+    // identical bit patterns, except that any NaN equals any NaN
+    const auto same = [](const double x, const double y) {
+        return (std::isnan(x) && std::isnan(y)) || std::bit_cast<std::uint64_t>(x) == std::bit_cast<std::uint64_t>(y);
+    };
+
+    simplify_pass_t pass;
+    for (int round = 0; round < 500; ++round) {
+        ast_t ast;
+        ast.m_root = generate(ast, generate, 6);
+        const auto simplified = pass.run(ast);
+        CHECK(simplified.size() <= reachable_nodes(ast));
+
+        for (int sample = 0; sample < 4; ++sample) {
+            state_t state(6);
+            for (auto &value: state) {
+                value = values[pick(std::size(values))];
+            }
+            auto expected_state = state;
+            double value = 0;
+            double expected = 0;
+            bool failed = false;
+            bool expected_failed = false;
+            try {
+                expected = ast(expected_state);
+            } catch (const std::logic_error &) {
+                expected_failed = true;
+            }
+            try {
+                value = simplified(state);
+            } catch (const std::logic_error &) {
+                failed = true;
+            }
+            REQUIRE(failed == expected_failed);
+            CHECK(same(value, expected));
+            for (std::size_t id = 0; id < state.size(); ++id) {
+                CHECK(same(state[id], expected_state[id]));
+            }
+        }
+    }
+    CHECK(pass.m_stats.m_nodes_after < pass.m_stats.m_nodes_before);
+}
+
+TEST_CASE("Long chains are simplified without recursion")
+{
+    auto sys = symbol_table_t{};
+    (void) sys.variable("a", 0.5);
+    (void) sys.variable("b", 0.25);
+    auto &state = sys.m_state;
+
+    std::string chain = "a";
+    for (int i = 0; i < 100'000; ++i) {
+        chain += "+b*1";
+    }
+    const auto ast = parse_ast(chain, sys);
+    const auto simplified = simplify(ast);
+    // every b*1 became b
+    CHECK(simplified.size() == 1 + 2 * 100'000);
+    ast_evaluator_t evaluator;
+    CHECK(evaluator.run(simplified, state) == evaluator.run(ast, state));
+
+    // comparing the two long operands of x - x, and checking that they are pure, does not recurse either
+    const auto difference = parse_ast("(" + chain + ")-(" + chain + ")", sys);
+    const auto zero = simplify(difference, {true});
+    CHECK(zero.size() == 1);
+    CHECK(evaluator.run(zero, state) == 0);
+}
@@ -0,0 +1,115 @@
+#include "string_arena.hpp"
+#include "expr.hpp"
+
+#include <doctest/doctest.h>
+
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+TEST_CASE("String arena")
+{
+    string_arena_t arena;
+
+    SUBCASE("Stored texts are copies that stay put")
+    {
+        std::string text = "x0";
+        const auto first = arena.store(text);
+        text[1] = '1';
+        CHECK(first == "x0");
+        CHECK(first.data() != text.data());
+
+        std::vector<std::string_view> views{first};
+        for (int i = 1; i < 5000; ++i) {
+            views.push_back(arena.store("x" + std::to_string(i)));
+        }
+        CHECK(views[0].data() == first.data());
+        std::size_t intact = 0;
+        for (int i = 0; i < 5000; ++i) {
+            intact += views[static_cast<std::size_t>(i)] == "x" + std::to_string(i);
+        }
+        CHECK(intact == 5000);
+        // short texts are packed rather than allocated one by one
+        CHECK(arena.chunks() < 10);
+        CHECK(arena.bytes() == 2 * 10 + 3 * 90 + 4 * 900 + 5 * 4000);
+    }
+    SUBCASE("Neighbouring texts are contiguous")
+    {
+        const auto a = arena.store("abc");
+        const auto b = arena.store("de");
+        CHECK(b.data() == a.data() + a.size());
+    }
+    SUBCASE("Long texts and empty texts")
+    {
+        const auto small = arena.store("small");
+        const std::string long_text(string_arena_t::chunk_size * 2, 'l');
+        CHECK(arena.store(long_text) == long_text);
+        CHECK(arena.store("").empty());
+        // the long text did not use up the current chunk
+        CHECK(arena.store("next").data() == small.data() + small.size());
+    }
+    SUBCASE("Copies share the text but not the free space")
+    {
+        const auto a = arena.store("a");
+        auto copy = arena;
+        CHECK(copy.chunks() == arena.chunks());
+        CHECK(copy.bytes() == arena.bytes());
+        const auto b = arena.store("b");
+        const auto c = copy.store("c");
+        CHECK(a == "a");
+        CHECK(b == "b");
+        CHECK(c == "c");
+        CHECK(b.data() == a.data() + 1);
+        CHECK(copy.chunks() == arena.chunks() + 1);
+    }
+    SUBCASE("Views outlive the arena they came from through its copies")
+    {
+        std::string_view view;
+        string_arena_t copy;
+        {
+            string_arena_t original;
+            view = original.store("kept");
+            copy = original;
+        }
+        CHECK(view == "kept");
+        auto moved = std::move(copy);
+        CHECK(view == "kept");
+        CHECK(moved.bytes() == 4);
+    }
+}
+
+TEST_CASE("Symbol table names live in its arena")
+{
+    auto sys = symbol_table_t{};
+    const auto a = sys.variable(std::string{"alpha"}, 1);
+    const auto b = sys.variable("beta", 2);
+    const auto alpha = sys.name(a.m_id);
+    CHECK(sys.name(b.m_id).data() == alpha.data() + alpha.size());
+
+    SUBCASE("Copies share names and grow independently")
+    {
+        auto copy = sys;
+        CHECK(copy.name(a.m_id).data() == alpha.data());
+        const auto gamma = copy.variable("gamma", 3);
+        const auto delta = sys.variable("delta", 4);
+        CHECK(copy.name(gamma.m_id) == "gamma");
+        CHECK(sys.name(delta.m_id) == "delta");
+        CHECK(copy.find("delta") == symbol_table_t::npos);
+        CHECK(sys.find("gamma") == symbol_table_t::npos);
+    }
+    SUBCASE("Names survive the table being moved and destroyed")
+    {
+        std::string_view name;
+        {
+            auto moved = std::move(sys);
+            name = moved.name(b.m_id);
+            std::stringstream ss;
+            ss << printer{moved, variable_t{a.m_id} + variable_t{b.m_id}};
+            CHECK(ss.str() == "alpha+beta");
+            sys = moved;
+        }
+        CHECK(name == "beta");
+        CHECK(sys.find("beta") == b.m_id);
+    }
+}
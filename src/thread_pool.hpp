@@ -0,0 +1,175 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/*
+ * A fixed set of worker threads with one task queue each. Work is spread over the queues; a worker takes from the
+ * back of its own queue and steals from the front of the others' when it runs dry. parallel_for() is the only way
+ * in: it returns once every index has run, which makes it a barrier, and the calling thread executes tasks while it
+ * waits, so parallel_for() may be called from inside a task without deadlocking.
+ */
+struct thread_pool_t {
+    explicit thread_pool_t(const std::size_t threads = std::thread::hardware_concurrency()) : m_queues(threads) {
+        m_workers.reserve(threads);
+        for (std::size_t index = 0; index < threads; ++index) {
+            m_workers.emplace_back([this, index] { work(index); });
+        }
+    }
+
+    thread_pool_t(const thread_pool_t &) = delete;
+    thread_pool_t &operator=(const thread_pool_t &) = delete;
+
+    ~thread_pool_t() {
+        {
+            std::lock_guard lock{m_mutex};
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        for (auto &worker: m_workers) {
+            worker.join();
+        }
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept {
+        return m_workers.size();
+    }
+
+    // Calls function(i) for every i in [0, count), in parallel, and rethrows the first exception any call threw.
+    template<typename Function>
+    void parallel_for(const std::size_t count, Function &&function) {
+        if (count == 0) {
+            return;
+        }
+        if (count == 1 || m_workers.empty()) {
+            for (std::size_t i = 0; i < count; ++i) {
+                function(i);
+            }
+            return;
+        }
+
+        group_t group;
+        group.m_invoke = [](const void *context, const std::size_t index) {
+            (*static_cast<const std::remove_reference_t<Function> *>(context))(index);
+        };
+        group.m_function = &function;
+        group.m_pending = count;
+        {
+            // counted before they are queued, so a task is never taken before it is counted
+            std::lock_guard lock{m_mutex};
+            m_queued += count;
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            const auto queue = m_next_queue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+            std::lock_guard lock{m_queues[queue].m_mutex};
+            m_queues[queue].m_tasks.push_back({&group, i});
+        }
+        m_wake.notify_all();
+
+        // help out instead of blocking until this group is done
+        for (;;) {
+            const auto completed = m_completed.load();
+            if (group.m_pending.load() == 0) {
+                break;
+            }
+            if (task_t task; take(m_next_queue.load(std::memory_order_relaxed), task)) {
+                run(task);
+            } else {
+                m_completed.wait(completed);
+            }
+        }
+        if (group.m_error) {
+            std::rethrow_exception(group.m_error);
+        }
+    }
+
+private:
+    // One parallel_for() call; it lives on the caller's stack until all of its tasks have finished.
+    struct group_t {
+        void (*m_invoke)(const void *, std::size_t) = nullptr;
+        const void *m_function = nullptr;
+        std::atomic<std::size_t> m_pending{0};
+        std::mutex m_error_mutex;
+        std::exception_ptr m_error;
+    };
+
+    struct task_t {
+        group_t *m_group;
+        std::size_t m_index;
+    };
+
+    struct queue_t {
+        std::mutex m_mutex;
+        std::deque<task_t> m_tasks;
+    };
+
+    std::vector<queue_t> m_queues;
+    std::vector<std::thread> m_workers;
+    std::atomic<std::size_t> m_next_queue{0};
+    // tasks sitting in any queue; workers sleep while it is zero
+    std::atomic<std::size_t> m_queued{0};
+    // bumped after every task, for parallel_for() callers waiting on their group
+    std::atomic<std::size_t> m_completed{0};
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stop = false;
+
+    // Takes a task from the back of queue `own`, or else steals one from the front of another queue.
+    bool take(const std::size_t own, task_t &task) {
+        for (std::size_t offset = 0; offset < m_queues.size(); ++offset) {
+            auto &queue = m_queues[(own + offset) % m_queues.size()];
+            std::lock_guard lock{queue.m_mutex};
+            if (queue.m_tasks.empty()) {
+                continue;
+            }
+            if (offset == 0) {
+                task = queue.m_tasks.back();
+                queue.m_tasks.pop_back();
+            } else {
+                task = queue.m_tasks.front();
+                queue.m_tasks.pop_front();
+            }
+            m_queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    void run(const task_t &task) {
+        auto &group = *task.m_group;
+        try {
+            group.m_invoke(group.m_function, task.m_index);
+        } catch (...) {
+            std::lock_guard lock{group.m_error_mutex};
+            if (!group.m_error) {
+                group.m_error = std::current_exception();
+            }
+        }
+        // the group may be gone as soon as its count reaches zero, so the waiter is woken through the pool instead
+        group.m_pending.fetch_sub(1);
+        m_completed.fetch_add(1);
+        m_completed.notify_all();
+    }
+
+    void work(const std::size_t index) {
+        for (;;) {
+            if (task_t task; take(index, task)) {
+                run(task);
+                continue;
+            }
+            std::unique_lock lock{m_mutex};
+            m_wake.wait(lock, [this] { return m_stop || m_queued.load() != 0; });
+            if (m_stop && m_queued.load() == 0) {
+                return;
+            }
+        }
+    }
+};